@@ -12,7 +12,7 @@ namespace samplog
 {
 	namespace internal
 	{
-		static const int API_VERSION = 1;
+		static const int API_VERSION = 2;
 		class IApi
 		{
 		public:
@@ -104,6 +104,8 @@ namespace samplog
 			_api->EraseAmx(amx);
 		}
 
+		// can be called from any thread, the file and function names
+		// stay valid as long as the AMX is registered
 		inline bool GetLastAmxFunctionCall(AMX * const amx,
 			AmxFuncCallInfo &destination)
 		{
@@ -3,6 +3,8 @@
 #include "LogLevel.hpp"
 
 #include <cstdint>
+#include <atomic>
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -19,6 +21,41 @@ namespace samplog
 		const char *function;
 	};
 
+	// a single argument of a log message with deferred formatting,
+	// strings only have to stay valid during the logging call
+	struct LogArgument
+	{
+		enum class Type
+		{
+			BOOL,
+			CHAR,
+			INT,
+			UINT,
+			DOUBLE,
+			STRING,
+			POINTER
+		};
+
+		Type type;
+		union
+		{
+			bool b;
+			char c;
+			long long i;
+			unsigned long long u;
+			double d;
+			struct
+			{
+				const char *data;
+				size_t length;
+			} s;
+			const void *p;
+		} value;
+	};
+
+	// handle of a native's parameter format, see ILogger::RegisterNativeCallFormat
+	class NativeCallFormat;
+
 	class ILogger
 	{
 	public:
@@ -32,7 +69,42 @@ namespace samplog
 
 		virtual bool Log(LogLevel level, std::string msg) = 0;
 
+		// doesn't wait for queued messages, they are still written afterwards
 		virtual void Destroy() = 0;
 		virtual ~ILogger() = default;
+
+		// since API version 2, added after all other functions to keep
+		// the vtable layout compatible with version 1
+		// 'format' uses the fmt library's format string syntax, the
+		// message is formatted on the logging thread
+		virtual bool LogFormat(LogLevel level, const char *format,
+			LogArgument const *args, size_t num_args,
+			std::vector<AmxFuncCallInfo> const &call_info) = 0;
+
+		// since API version 2
+		// the returned mask of enabled log levels stays valid as long as the
+		// logger exists and is updated when the log config changes, so
+		// callers can check log levels without calling into the library
+		virtual std::atomic<int> const *GetLogLevelMask() const = 0;
+
+		// since API version 2
+		// only captures the AMX's raw call trace, the call trace is resolved
+		// on the logging thread, fails if there's no debug info for the AMX
+		// 'format' is logged as it is if there are no arguments
+		virtual bool LogAmxFormat(AMX * const amx, LogLevel level, const char *format,
+			LogArgument const *args, size_t num_args) = 0;
+
+		// since API version 2
+		// compiles the parameter format of a native once (same specifiers as
+		// in LogNativeCall), the returned handle is owned by the logger and
+		// stays valid as long as it exists, nullptr if the format is invalid
+		virtual NativeCallFormat const *RegisterNativeCallFormat(const char *name,
+			const char *params_format) = 0;
+
+		// since API version 2
+		// same as LogNativeCall, but only captures the parameter values,
+		// the message is formatted on the logging thread
+		virtual bool LogNativeCallFormat(AMX * const amx, cell * const params,
+			NativeCallFormat const *format) = 0;
 	};
 }
@@ -3,15 +3,136 @@
 #include "Api.hpp"
 
 #include <string>
+#include <vector>
+#include <cstring>
+
+
+// mask of log levels compiled into PluginLogger calls, logging calls with
+// any other level are removed by the compiler (when called with a constant
+// level), e.g. define it as 30 to remove all DEBUG and VERBOSE messages
+// from release builds
+#ifndef SAMPLOG_COMPILED_LOG_LEVELS
+#  define SAMPLOG_COMPILED_LOG_LEVELS 63 // all log levels
+#endif
+
+// logs the result of the expression 'message' (std::string or const char *),
+// which is only evaluated if 'level' is enabled, e.g.
+//   SAMPLOG_LOG(logger, LogLevel::DEBUG, fmt::format("player {} connected", id));
+#define SAMPLOG_LOG(logger, level, message) \
+	(logger).LogLazy((level), [&]() { return (message); })
 
 
 namespace samplog
 {
+	namespace internal
+	{
+		inline constexpr bool IsCompiledLogLevel(LogLevel log_level)
+		{
+			return (SAMPLOG_COMPILED_LOG_LEVELS & log_level) == log_level;
+		}
+
+		inline LogArgument MakeLogArgument(bool value)
+		{
+			LogArgument arg;
+			arg.type = LogArgument::Type::BOOL;
+			arg.value.b = value;
+			return arg;
+		}
+		inline LogArgument MakeLogArgument(char value)
+		{
+			LogArgument arg;
+			arg.type = LogArgument::Type::CHAR;
+			arg.value.c = value;
+			return arg;
+		}
+		inline LogArgument MakeLogArgument(long long value)
+		{
+			LogArgument arg;
+			arg.type = LogArgument::Type::INT;
+			arg.value.i = value;
+			return arg;
+		}
+		inline LogArgument MakeLogArgument(unsigned long long value)
+		{
+			LogArgument arg;
+			arg.type = LogArgument::Type::UINT;
+			arg.value.u = value;
+			return arg;
+		}
+		inline LogArgument MakeLogArgument(signed char value)
+		{
+			return MakeLogArgument(static_cast<long long>(value));
+		}
+		inline LogArgument MakeLogArgument(short value)
+		{
+			return MakeLogArgument(static_cast<long long>(value));
+		}
+		inline LogArgument MakeLogArgument(int value)
+		{
+			return MakeLogArgument(static_cast<long long>(value));
+		}
+		inline LogArgument MakeLogArgument(long value)
+		{
+			return MakeLogArgument(static_cast<long long>(value));
+		}
+		inline LogArgument MakeLogArgument(unsigned char value)
+		{
+			return MakeLogArgument(static_cast<unsigned long long>(value));
+		}
+		inline LogArgument MakeLogArgument(unsigned short value)
+		{
+			return MakeLogArgument(static_cast<unsigned long long>(value));
+		}
+		inline LogArgument MakeLogArgument(unsigned int value)
+		{
+			return MakeLogArgument(static_cast<unsigned long long>(value));
+		}
+		inline LogArgument MakeLogArgument(unsigned long value)
+		{
+			return MakeLogArgument(static_cast<unsigned long long>(value));
+		}
+		inline LogArgument MakeLogArgument(double value)
+		{
+			LogArgument arg;
+			arg.type = LogArgument::Type::DOUBLE;
+			arg.value.d = value;
+			return arg;
+		}
+		inline LogArgument MakeLogArgument(float value)
+		{
+			return MakeLogArgument(static_cast<double>(value));
+		}
+		inline LogArgument MakeLogArgument(const char *value)
+		{
+			LogArgument arg;
+			arg.type = LogArgument::Type::STRING;
+			arg.value.s.data = value != nullptr ? value : "(null)";
+			arg.value.s.length = std::strlen(arg.value.s.data);
+			return arg;
+		}
+		inline LogArgument MakeLogArgument(std::string const &value)
+		{
+			LogArgument arg;
+			arg.type = LogArgument::Type::STRING;
+			arg.value.s.data = value.data();
+			arg.value.s.length = value.length();
+			return arg;
+		}
+		inline LogArgument MakeLogArgument(const void *value)
+		{
+			LogArgument arg;
+			arg.type = LogArgument::Type::POINTER;
+			arg.value.p = value;
+			return arg;
+		}
+	}
+
 	class PluginLogger
 	{
 	public:
 		explicit PluginLogger(std::string pluginname) :
-			_logger(Api::Get()->CreateLogger(pluginname.insert(0, "plugins/").c_str()))
+			_logger(Api::Get()->CreateLogger(pluginname.insert(0, "plugins/").c_str())),
+			_logLevelMask(_logger->GetLogLevelMask())
 		{ }
 		~PluginLogger() = default;
 		PluginLogger(PluginLogger const &rhs) = delete;
@@ -21,35 +142,97 @@ namespace samplog
 
 	private:
 		Logger_t _logger;
+		std::atomic<int> const *_logLevelMask; // owned by the logger
 
 	public:
-		inline bool IsLogLevel(LogLevel log_level)
+		// doesn't call into the library
+		inline bool IsLogLevel(LogLevel log_level) const
 		{
-			return _logger->IsLogLevel(log_level);
+			return internal::IsCompiledLogLevel(log_level)
+				&& (_logLevelMask->load(std::memory_order_relaxed) & log_level) == log_level;
 		}
 
 		inline bool Log(LogLevel level, const char *msg)
 		{
-			return _logger->Log(level, msg);
+			return IsLogLevel(level) && _logger->Log(level, msg);
 		}
 
 		inline bool Log(LogLevel level, const char *msg,
 			std::vector<AmxFuncCallInfo> const &call_info)
 		{
-			return _logger->Log(level, msg, call_info);
+			return IsLogLevel(level) && _logger->Log(level, msg, call_info);
 		}
 
 		inline bool Log(AMX * const amx, const LogLevel level, const char *msg)
 		{
-			std::vector<AmxFuncCallInfo> call_info;
-			return Api::Get()->GetAmxFunctionCallTrace(amx, call_info)
-				&& _logger->Log(level, msg, call_info);
+			return IsLogLevel(level)
+				&& _logger->LogAmxFormat(amx, level, msg, nullptr, 0);
+		}
+
+		// the arguments are copied and formatted later on the logging thread,
+		// using the fmt library's format string syntax ("{}", "{:08x}", ...)
+		// supported argument types are all arithmetic types, strings and pointers
+		template<typename... Args>
+		inline bool Log(LogLevel level, const char *format, Args const &... args)
+		{
+			if (!IsLogLevel(level))
+				return false;
+
+			static const std::vector<AmxFuncCallInfo> empty_call_info;
+			LogArgument const arguments[] = { internal::MakeLogArgument(args)... };
+			return _logger->LogFormat(level, format,
+				arguments, sizeof...(Args), empty_call_info);
+		}
+
+		template<typename... Args>
+		inline bool Log(AMX * const amx, const LogLevel level, const char *format,
+			Args const &... args)
+		{
+			if (!IsLogLevel(level))
+				return false;
+
+			LogArgument const arguments[] = { internal::MakeLogArgument(args)... };
+			return _logger->LogAmxFormat(amx, level, format,
+				arguments, sizeof...(Args));
+		}
+
+		// 'build_message' is only called if the log level is enabled and
+		// returns the message (std::string or anything convertible to it)
+		template<typename Func>
+		inline bool LogLazy(LogLevel level, Func &&build_message)
+		{
+			return IsLogLevel(level)
+				&& _logger->Log(level, std::string(build_message()));
+		}
+
+		template<typename Func>
+		inline bool LogLazy(AMX * const amx, const LogLevel level, Func &&build_message)
+		{
+			return IsLogLevel(level)
+				&& _logger->LogAmxFormat(amx, level,
+					std::string(build_message()).c_str(), nullptr, 0);
 		}
 
 		inline bool LogNativeCall(AMX * const amx, cell * const params,
 			const char *name, const char *params_format)
 		{
-			return _logger->LogNativeCall(amx, params, name, params_format);
+			return IsLogLevel(LogLevel::DEBUG)
+				&& _logger->LogNativeCall(amx, params, name, params_format);
+		}
+
+		// the format is compiled once instead of on every call, the returned
+		// handle stays valid as long as the logger exists
+		inline NativeCallFormat const *RegisterNativeCall(const char *name,
+			const char *params_format)
+		{
+			return _logger->RegisterNativeCallFormat(name, params_format);
+		}
+
+		inline bool LogNativeCall(AMX * const amx, cell * const params,
+			NativeCallFormat const *format)
+		{
+			return IsLogLevel(LogLevel::DEBUG)
+				&& _logger->LogNativeCallFormat(amx, params, format);
 		}
 
 		inline bool operator()(LogLevel level, const char *msg)
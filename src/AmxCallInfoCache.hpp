@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "amx/amx.h"
+#include <samplog/ILogger.hpp>
+
+
+// bounded cache of resolved code addresses of a single AMX instance
+// direct-mapped: every address has exactly one slot, a newly resolved
+// address simply replaces the previous one in that slot
+// lock-free: every slot has its own sequence number (a seqlock), a read
+// that overlaps with a write of the same slot counts as a miss, and a
+// write is skipped if another thread is writing the same slot
+class AmxCallInfoCache
+{
+public:
+	static const size_t SIZE = 1024; // has to be a power of two
+
+public:
+	AmxCallInfoCache() :
+		_hits(0),
+		_misses(0)
+	{ }
+	~AmxCallInfoCache() = default;
+	AmxCallInfoCache(AmxCallInfoCache const &) = delete;
+	AmxCallInfoCache& operator=(AmxCallInfoCache const &) = delete;
+
+private:
+	// the fields are atomics only so concurrent reads and writes are
+	// well-defined, the sequence number orders them
+	struct Entry
+	{
+		// odd while the slot is written, 0 if it was never written
+		std::atomic<unsigned int> Sequence{ 0 };
+		std::atomic<bool> Found{ false }; // whether the address could be resolved at all
+		std::atomic<ucell> Address{ 0 };
+		std::atomic<int> Line{ 0 };
+		std::atomic<const char *> File{ nullptr };
+		std::atomic<const char *> Function{ nullptr };
+	};
+
+	Entry _entries[SIZE];
+	std::atomic<unsigned long long> _hits;
+	std::atomic<unsigned long long> _misses;
+
+private:
+	inline Entry &GetEntry(ucell address)
+	{
+		// code addresses are cell-aligned
+		return _entries[((address >> 2) ^ (address >> 12)) & (SIZE - 1)];
+	}
+
+public:
+	// returns false if the address isn't cached, otherwise 'found' tells
+	// if the address could be resolved
+	// can be called from any thread
+	inline bool Get(ucell address, bool &found, samplog::AmxFuncCallInfo &dest)
+	{
+		Entry const &entry = GetEntry(address);
+		unsigned int const sequence = entry.Sequence.load(std::memory_order_acquire);
+		if (sequence != 0 && (sequence & 1) == 0
+			&& entry.Address.load(std::memory_order_relaxed) == address)
+		{
+			bool const entry_found = entry.Found.load(std::memory_order_relaxed);
+			samplog::AmxFuncCallInfo const info{
+				entry.Line.load(std::memory_order_relaxed),
+				entry.File.load(std::memory_order_relaxed),
+				entry.Function.load(std::memory_order_relaxed)
+			};
+
+			// the slot wasn't written while it was read
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (entry.Sequence.load(std::memory_order_relaxed) == sequence)
+			{
+				++_hits;
+				found = entry_found;
+				if (found)
+					dest = info;
+				return true;
+			}
+		}
+
+		++_misses;
+		return false;
+	}
+
+	// can be called from any thread
+	inline void Put(ucell address, bool found, samplog::AmxFuncCallInfo const &info)
+	{
+		Entry &entry = GetEntry(address);
+		unsigned int sequence = entry.Sequence.load(std::memory_order_relaxed);
+		if ((sequence & 1) != 0
+			|| !entry.Sequence.compare_exchange_strong(sequence, sequence + 1,
+				std::memory_order_relaxed))
+		{
+			return; // another thread is writing this slot
+		}
+		std::atomic_thread_fence(std::memory_order_release);
+
+		entry.Found.store(found, std::memory_order_relaxed);
+		entry.Address.store(address, std::memory_order_relaxed);
+		entry.Line.store(info.line, std::memory_order_relaxed);
+		entry.File.store(info.file, std::memory_order_relaxed);
+		entry.Function.store(info.function, std::memory_order_relaxed);
+
+		// skips 0 on overflow, which would mark the slot as never written
+		unsigned int next_sequence = sequence + 2;
+		if (next_sequence == 0)
+			next_sequence = 2;
+		entry.Sequence.store(next_sequence, std::memory_order_release);
+	}
+
+	inline unsigned long long GetHits() const
+	{
+		return _hits;
+	}
+	inline unsigned long long GetMisses() const
+	{
+		return _misses;
+	}
+};
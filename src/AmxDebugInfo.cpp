@@ -0,0 +1,210 @@
+#include "AmxDebugInfo.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace
+{
+	// bounds checked reader for the debug info tables, the layout is the
+	// same as parsed by dbg_LoadInfo (little-endian only)
+	class TableReader
+	{
+	public:
+		TableReader(unsigned char const *begin, unsigned char const *end) :
+			_pos(begin),
+			_end(end)
+		{ }
+
+	private:
+		unsigned char const *_pos;
+		unsigned char const *const _end;
+
+	public:
+		inline unsigned char const *GetPosition() const
+		{
+			return _pos;
+		}
+		inline size_t GetRemaining() const
+		{
+			return static_cast<size_t>(_end - _pos);
+		}
+
+		inline bool Skip(size_t size)
+		{
+			if (GetRemaining() < size)
+				return false;
+			_pos += size;
+			return true;
+		}
+
+		// entries with a name consist of a fixed part, which includes the
+		// first character of the name, followed by the rest of the name
+		template<typename T>
+		bool ReadNamedEntry(T const *&entry)
+		{
+			if (GetRemaining() < sizeof(T))
+				return false;
+
+			entry = reinterpret_cast<T const *>(_pos);
+			auto const *name_end = static_cast<unsigned char const *>(
+				std::memchr(_pos + sizeof(T) - 1, '\0', GetRemaining() - sizeof(T) + 1));
+			if (name_end == nullptr)
+				return false;
+
+			_pos = name_end + 1;
+			return true;
+		}
+	};
+}
+
+
+size_t AmxDebugInfo::AddName(const char *name)
+{
+	size_t const offset = _names.size();
+	_names.insert(_names.end(), name, name + std::strlen(name) + 1);
+	return offset;
+}
+
+bool AmxDebugInfo::Load(MappedFile const &file)
+{
+	unsigned char const *data = file.GetData();
+	size_t const size = file.GetSize();
+
+	if (size < sizeof(AMX_HEADER))
+		return false;
+
+	auto const &amx_hdr = *reinterpret_cast<AMX_HEADER const *>(data);
+	if (amx_hdr.magic != AMX_MAGIC || (amx_hdr.flags & AMX_FLAG_DEBUG) == 0
+		|| amx_hdr.size < 0 || static_cast<size_t>(amx_hdr.size) > size - sizeof(AMX_DBG_HDR))
+	{
+		return false;
+	}
+
+	auto const &dbg_hdr = *reinterpret_cast<AMX_DBG_HDR const *>(data + amx_hdr.size);
+	if (dbg_hdr.magic != AMX_DBG_MAGIC || dbg_hdr.size < sizeof(AMX_DBG_HDR)
+		|| dbg_hdr.size > size - amx_hdr.size)
+	{
+		return false;
+	}
+
+	TableReader reader(data + amx_hdr.size + sizeof(AMX_DBG_HDR),
+		data + amx_hdr.size + dbg_hdr.size);
+
+	_files.reserve(dbg_hdr.files);
+	for (int i = 0; i != dbg_hdr.files; ++i)
+	{
+		AMX_DBG_FILE const *dbg_file;
+		if (!reader.ReadNamedEntry(dbg_file))
+			return false;
+		_files.push_back({ dbg_file->address, AddName(dbg_file->name) });
+	}
+
+	auto const *lines = reinterpret_cast<AMX_DBG_LINE const *>(reader.GetPosition());
+	size_t num_lines = dbg_hdr.lines;
+	if (!reader.Skip(num_lines * sizeof(AMX_DBG_LINE)))
+		return false;
+
+	// workaround for possible overflow of the 16-bit line count,
+	// same as in dbg_LoadInfo: the line table continues as long
+	// as the addresses keep increasing
+	const size_t LINE_COUNT_OVERFLOW = 0x10000;
+	while (num_lines != 0 && reader.GetRemaining() >= LINE_COUNT_OVERFLOW * sizeof(AMX_DBG_LINE)
+		&& lines[num_lines].address > lines[num_lines - 1].address)
+	{
+		reader.Skip(LINE_COUNT_OVERFLOW * sizeof(AMX_DBG_LINE));
+		num_lines += LINE_COUNT_OVERFLOW;
+	}
+
+	for (int i = 0; i != dbg_hdr.symbols; ++i)
+	{
+		AMX_DBG_SYMBOL const *symbol;
+		if (!reader.ReadNamedEntry(symbol)
+			|| !reader.Skip(symbol->dim * sizeof(AMX_DBG_SYMDIM)))
+		{
+			return false;
+		}
+
+		if (symbol->ident == iFUNCTN)
+			_functions.push_back({ symbol->codestart, symbol->codeend, AddName(symbol->name) });
+	}
+
+	_lines.reserve(num_lines);
+	for (size_t i = 0; i != num_lines; ++i)
+		_lines.push_back({ lines[i].address, lines[i].line });
+	_names.shrink_to_fit();
+
+	// the tables are usually already sorted, but the debug info format
+	// doesn't guarantee it
+	std::stable_sort(_lines.begin(), _lines.end(),
+		[](LineEntry const &lhs, LineEntry const &rhs)
+	{
+		return lhs.Address < rhs.Address;
+	});
+	std::stable_sort(_files.begin(), _files.end(),
+		[](FileEntry const &lhs, FileEntry const &rhs)
+	{
+		return lhs.Address < rhs.Address;
+	});
+	std::stable_sort(_functions.begin(), _functions.end(),
+		[](FunctionEntry const &lhs, FunctionEntry const &rhs)
+	{
+		return lhs.CodeStart < rhs.CodeStart;
+	});
+
+	return true;
+}
+
+bool AmxDebugInfo::LookupLine(ucell address, int &line) const
+{
+	auto it = std::upper_bound(_lines.begin(), _lines.end(), address,
+		[](ucell addr, LineEntry const &entry)
+	{
+		return addr < entry.Address;
+	});
+
+	if (it == _lines.end())
+		return false; // invalid address
+
+	if (it == _lines.begin())
+		return false; // not found
+
+	line = std::prev(it)->Line + 1;
+	return true;
+}
+
+bool AmxDebugInfo::LookupFile(ucell address, const char *&filename) const
+{
+	auto it = std::upper_bound(_files.begin(), _files.end(), address,
+		[](ucell addr, FileEntry const &entry)
+	{
+		return addr < entry.Address;
+	});
+
+	if (it == _files.begin())
+		return false;
+
+	filename = _names.data() + std::prev(it)->Name;
+	return true;
+}
+
+bool AmxDebugInfo::LookupFunction(ucell address, const char *&funcname) const
+{
+	// functions don't overlap, so only the last function starting
+	// at or before the address can contain it
+	auto it = std::upper_bound(_functions.begin(), _functions.end(), address,
+		[](ucell addr, FunctionEntry const &entry)
+	{
+		return addr < entry.CodeStart;
+	});
+
+	if (it == _functions.begin())
+		return false;
+
+	auto const &function = *std::prev(it);
+	if (address >= function.CodeEnd)
+		return false;
+
+	funcname = _names.data() + function.Name;
+	return true;
+}
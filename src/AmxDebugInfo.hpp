@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "MappedFile.hpp"
+#include "amx/amx.h"
+#include "amx/amxdbg.h"
+#include <samplog/ILogger.hpp>
+
+
+// debug information of a single AMX file, with address-sorted lookup
+// tables built once when loading, so that every lookup is a binary search
+// instead of a linear scan over the debug info tables
+// the debug info is parsed directly from the memory mapped file, only
+// lines, file names and function names are kept, all other symbols
+// (which make up most of the debug info) are skipped
+class AmxDebugInfo
+{
+public:
+	AmxDebugInfo() = default;
+	~AmxDebugInfo() = default;
+	AmxDebugInfo(AmxDebugInfo const &) = delete;
+	AmxDebugInfo& operator=(AmxDebugInfo const &) = delete;
+	AmxDebugInfo(AmxDebugInfo &&) = delete;
+	AmxDebugInfo& operator=(AmxDebugInfo &&) = delete;
+
+private:
+	struct LineEntry
+	{
+		ucell Address;
+		int32_t Line;
+	};
+	// names are stored as offsets into '_names'
+	struct FileEntry
+	{
+		ucell Address;
+		size_t Name;
+	};
+	struct FunctionEntry
+	{
+		ucell CodeStart;
+		ucell CodeEnd;
+		size_t Name;
+	};
+
+	std::vector<LineEntry> _lines;
+	std::vector<FileEntry> _files;
+	std::vector<FunctionEntry> _functions;
+	std::vector<char> _names;
+
+private:
+	size_t AddName(const char *name);
+
+public:
+	// the file isn't referenced anymore after loading, as it might be
+	// changed (e.g. recompiled) while the script is still loaded
+	// returns false if the file has no (or invalid) debug info
+	bool Load(MappedFile const &file);
+
+	// the returned line is one-based
+	bool LookupLine(ucell address, int &line) const;
+	bool LookupFile(ucell address, const char *&filename) const;
+	bool LookupFunction(ucell address, const char *&funcname) const;
+	// looks up line, file and function at once, fails if any of them fails
+	inline bool LookupFunctionCall(ucell address, samplog::AmxFuncCallInfo &dest) const
+	{
+		return LookupLine(address, dest.line)
+			&& LookupFile(address, dest.file)
+			&& LookupFunction(address, dest.function);
+	}
+};
+
+// resolves the captured code addresses of a call trace (the instruction
+// pointer followed by the return addresses of all calling functions),
+// 'get_function_call' resolves a single address like LookupFunctionCall
+template<typename Func>
+void ResolveAmxCallTrace(std::uint32_t const *addresses, size_t num_addresses,
+	std::vector<samplog::AmxFuncCallInfo> &dest, Func &&get_function_call)
+{
+	samplog::AmxFuncCallInfo call_info;
+
+	// the first address is the current instruction pointer
+	if (num_addresses == 0 || !get_function_call(addresses[0], call_info))
+		return;
+
+	dest.push_back(call_info);
+
+	for (size_t i = 1; i != num_addresses; ++i)
+	{
+		if (get_function_call(addresses[i], call_info))
+			dest.push_back(call_info);
+		else
+			dest.push_back({ 0, "<unknown>", "<unknown>" });
+	}
+
+	//HACK: for some reason the oldest/highest call (not cip though) 
+	//      has a slightly incorrect ret_addr
+	if (dest.size() > 1)
+		dest.back().line--;
+}
@@ -1,15 +1,114 @@
 #include "AmxDebugManager.hpp"
 #include "SampConfigReader.hpp"
 #include "LogConfig.hpp"
+#include "LogManager.hpp"
+#include "LogRecord.hpp"
+#include "MappedFile.hpp"
 
 #include <cassert>
 #include <tinydir.h>
 #include <algorithm>
 #include <vector>
+#include <chrono>
 
 using samplog::AmxFuncCallInfo;
 
 
+namespace
+{
+	// FNV-1a
+	const uint64_t HASH_OFFSET_BASIS = 14695981039346656037ULL;
+	const uint64_t HASH_PRIME = 1099511628211ULL;
+
+	inline uint64_t HashBytes(void const *data, size_t size,
+		uint64_t hash = HASH_OFFSET_BASIS)
+	{
+		auto const *bytes = static_cast<unsigned char const *>(data);
+		for (size_t i = 0; i != size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= HASH_PRIME;
+		}
+		return hash;
+	}
+
+	// returns false if the table offsets in the header are invalid
+	inline bool IsValidHeader(AMX_HEADER const &header)
+	{
+		return header.publics >= static_cast<int32_t>(sizeof(AMX_HEADER))
+			&& header.natives >= header.publics
+			&& header.nametable >= header.natives
+			&& header.cod >= header.nametable
+			&& header.size >= header.cod;
+	}
+
+	// the index hash covers the header, the public functions table and the
+	// name table, which (unlike the natives table and the code section)
+	// are not modified when the AMX is loaded
+	// 'base' points to the AMX image, the header has to be valid
+	inline uint64_t GetIndexHash(unsigned char const *base)
+	{
+		auto const &header = *reinterpret_cast<AMX_HEADER const *>(base);
+		uint64_t hash = HashBytes(base, sizeof(AMX_HEADER));
+		hash = HashBytes(base + header.publics, header.natives - header.publics, hash);
+		return HashBytes(base + header.nametable, header.cod - header.nametable, hash);
+	}
+
+	// returns false if the mapped file doesn't contain a valid AMX image
+	inline bool GetFileHeader(MappedFile const &file, AMX_HEADER const *&header)
+	{
+		if (file.GetSize() < sizeof(AMX_HEADER))
+			return false;
+
+		header = reinterpret_cast<AMX_HEADER const *>(file.GetData());
+		return IsValidHeader(*header)
+			&& static_cast<size_t>(header->size) <= file.GetSize();
+	}
+
+	// reads the header and computes the index hash of a script file
+	bool ReadFileIndexHash(FILE *amx_file, AMX_HEADER &header, uint64_t &hash)
+	{
+		/*
+		  The following two lines are stripped from AMX helper function "aux_LoadProgram".
+		  There are some additional endianess checks and alignments, but these are only
+		  important if the system is using big endian. We assume that this library always runs on
+		  litte-endian machines, since the SA-MP server only runs on x86(-64) architecture.
+		*/
+		if (fread(&header, sizeof header, 1, amx_file) != 1 || !IsValidHeader(header))
+			return false;
+
+		/*if (hdr.magic != AMX_MAGIC) {
+			fclose(fp);
+			return AMX_ERR_FORMAT;
+		}*/
+
+		// everything before the code section
+		std::vector<unsigned char> image_prefix(header.cod);
+		if (fseek(amx_file, 0, SEEK_SET) != 0
+			|| fread(image_prefix.data(), image_prefix.size(), 1, amx_file) != 1)
+		{
+			return false;
+		}
+
+		hash = GetIndexHash(image_prefix.data());
+		return true;
+	}
+
+	// hashes the code section of the script file, only used to tell
+	// apart different scripts with the same index hash
+	bool GetFileCodeHash(std::string const &filepath, uint64_t &hash)
+	{
+		MappedFile file;
+		AMX_HEADER const *header;
+		if (!file.Open(filepath) || !GetFileHeader(file, header))
+			return false;
+
+		hash = HashBytes(file.GetData() + header->cod, header->size - header->cod);
+		return true;
+	}
+}
+
+
 AmxDebugManager::AmxDebugManager()
 {
 	if (LogConfig::Get()->GetGlobalConfig().DisableDebugInfo)
@@ -23,26 +122,49 @@ AmxDebugManager::AmxDebugManager()
 	if (!SampConfigReader::Get()->GetGamemodeList(gamemodes))
 		return;
 
+	_indexingDone = false;
+	_indexThread = std::thread(&AmxDebugManager::IndexScripts, this, std::move(gamemodes));
+}
+
+AmxDebugManager::~AmxDebugManager()
+{
+	if (_indexThread.joinable())
+		_indexThread.join();
+
+	// AMX instances have to be destroyed before the debug info they use
+	std::atomic_store(&_amxDebugMap, std::make_shared<AmxDebugMap const>());
+}
+
+void AmxDebugManager::IndexScripts(std::vector<std::string> gamemodes)
+{
+	auto const start_time = std::chrono::steady_clock::now();
+
+	// only the script headers are read here, the debug info is
+	// loaded when a matching AMX is registered
 	for (auto &g : gamemodes)
 	{
 		std::string amx_filepath = "gamemodes/" + g + ".amx";
-		InitDebugData(amx_filepath.c_str());
+		IndexScript(amx_filepath.c_str());
 	}
 
-	//load ALL filterscripts (there's no other way since filterscripts can be dynamically (un)loaded
-	InitDebugDataDir("filterscripts");
-}
+	//index ALL filterscripts (there's no other way since filterscripts can be dynamically (un)loaded
+	IndexScriptDir("filterscripts");
 
-AmxDebugManager::~AmxDebugManager()
-{
-	for (auto &a : _availableDebugInfo)
+	size_t num_scripts;
 	{
-		delete a.first;
-		delete a.second;
+		std::lock_guard<std::mutex> lock(_scriptsLock);
+		_indexingDone = true;
+		num_scripts = _scripts.size();
 	}
+	_scriptsIndexed.notify_all();
+
+	LogManager::Get()->LogInternal(samplog::LogLevel::INFO, fmt::format(
+		"indexed {:d} scripts with debug info in {:.1f} ms", num_scripts,
+		std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start_time).count()));
 }
 
-void AmxDebugManager::InitDebugDataDir(const char *directory)
+void AmxDebugManager::IndexScriptDir(const char *directory)
 {
 	tinydir_dir dir;
 	memset(&dir, 0, sizeof(decltype(dir)));
@@ -55,9 +177,9 @@ void AmxDebugManager::InitDebugDataDir(const char *directory)
 		tinydir_readfile(&dir, &file);
 
 		if (file.is_dir && file.name[0] != '.')
-			InitDebugDataDir(file.path);
+			IndexScriptDir(file.path);
 		else if (!strcmp(file.extension, "amx"))
-			InitDebugData(file.path);
+			IndexScript(file.path);
 
 		tinydir_next(&dir);
 	}
@@ -65,118 +187,236 @@ void AmxDebugManager::InitDebugDataDir(const char *directory)
 	tinydir_close(&dir);
 }
 
-bool AmxDebugManager::InitDebugData(const char *filepath)
+bool AmxDebugManager::IndexScript(const char *filepath)
 {
 	FILE* amx_file = fopen(filepath, "rb");
 	if (amx_file == nullptr)
 		return false;
 
-	/*
-	  The following two lines are stripped from AMX helper function "aux_LoadProgram".
-	  There are some additional endianess checks and alignments, but these are only
-	  important if the system is using big endian. We assume that this library always runs on
-	  litte-endian machines, since the SA-MP server only runs on x86(-64) architecture.
-	*/
 	AMX_HEADER hdr;
-	fread(&hdr, sizeof hdr, 1, amx_file);
-
-	/*if (hdr.magic != AMX_MAGIC) {
-		fclose(fp);
-		return AMX_ERR_FORMAT;
-	}*/
-
-	AMX_DBG amxdbg;
-	//dbg_LoadInfo already seeks to the beginning of the file
-	int error = dbg_LoadInfo(&amxdbg, amx_file);
+	uint64_t hash;
+	bool const success = ReadFileIndexHash(amx_file, hdr, hash)
+		&& (hdr.flags & AMX_FLAG_DEBUG) != 0;
 
 	fclose(amx_file);
 
-	if (error == AMX_ERR_NONE)
-		_availableDebugInfo.emplace(new AMX_HEADER(hdr), new AMX_DBG(amxdbg));
+	if (success)
+		AddScript(hdr, hash, filepath);
 
-	return (error == AMX_ERR_NONE);
+	return success;
 }
 
-void AmxDebugManager::RegisterAmx(AMX *amx)
+void AmxDebugManager::AddScript(AMX_HEADER const &header, uint64_t hash,
+	std::string file_path)
 {
-	if (_disableDebugInfo)
+	std::unique_lock<std::mutex> lock(_scriptsLock);
+	auto it = _scripts.find(hash);
+	if (it == _scripts.end())
+	{
+		_scripts.emplace(hash, ScriptEntry(header, std::move(file_path)));
+		lock.unlock();
+		_scriptsIndexed.notify_all();
+		return;
+	}
+
+	if (it->second.Ambiguous)
 		return;
 
-	if (_amxDebugMap.find(amx) != _amxDebugMap.end()) //amx already registered
+	// entries are only added by this thread and never erased, the code hashes
+	// are computed without the lock so registrations don't wait for it
+	bool const same_header = memcmp(&it->second.Header, &header, sizeof(AMX_HEADER)) == 0;
+	std::string const other_file_path = it->second.FilePath;
+	lock.unlock();
+
+	// copies of the same script can share their debug info
+	uint64_t code_hash, other_code_hash;
+	if (same_header
+		&& GetFileCodeHash(other_file_path, code_hash)
+		&& GetFileCodeHash(file_path, other_code_hash)
+		&& code_hash == other_code_hash)
+	{
 		return;
+	}
+
+	LogManager::Get()->LogInternal(samplog::LogLevel::WARNING, fmt::format(
+		"scripts \"{:s}\" and \"{:s}\" can't be told apart, "
+		"disabling debug info for both",
+		other_file_path, file_path));
+
+	lock.lock();
+	auto &entry = _scripts.at(hash);
+	entry.Ambiguous = true;
+
+	// AMX instances registered while the entry didn't look ambiguous yet
+	// might use the wrong debug info, so they lose it again
+	auto debug_info = entry.DebugInfo.lock();
+	if (debug_info)
+		EraseAmxInstances(debug_info.get());
+}
 
-	for (auto &d : _availableDebugInfo)
+void AmxDebugManager::EraseAmxInstances(AmxDebugInfo const *debug_info)
+{
+	std::lock_guard<std::mutex> map_lock(_amxDebugMapLock);
+	auto new_map = std::make_shared<AmxDebugMap>(*_amxDebugMap);
+	for (auto it = new_map->begin(); it != new_map->end(); )
 	{
-		if (memcmp(d.first, amx->base, sizeof(AMX_HEADER)) == 0)
-		{
-			_amxDebugMap.emplace(amx, d.second);
-			break;
-		}
+		if (it->second->GetDebugInfo() == debug_info)
+			it = new_map->erase(it);
+		else
+			++it;
 	}
+	std::atomic_store(&_amxDebugMap, std::shared_ptr<AmxDebugMap const>(std::move(new_map)));
 }
 
-void AmxDebugManager::EraseAmx(AMX *amx)
+std::shared_ptr<AmxDebugInfo const> AmxDebugManager::LoadDebugInfo(
+	uint64_t hash, ScriptEntry &entry)
 {
-	if (_disableDebugInfo)
-		return;
+	auto debug_info = entry.DebugInfo.lock();
+	if (debug_info)
+		return debug_info;
 
-	_amxDebugMap.erase(amx);
+	MappedFile file;
+	if (!file.Open(entry.FilePath))
+	{
+		LogManager::Get()->LogInternal(samplog::LogLevel::WARNING, fmt::format(
+			"could not open script \"{:s}\" to load its debug info", entry.FilePath));
+		return nullptr;
+	}
+
+	// the script might have been changed since it was indexed
+	AMX_HEADER const *header;
+	if (!GetFileHeader(file, header) || GetIndexHash(file.GetData()) != hash)
+	{
+		LogManager::Get()->LogInternal(samplog::LogLevel::WARNING, fmt::format(
+			"script \"{:s}\" was changed after server start, can't load its debug info",
+			entry.FilePath));
+		return nullptr;
+	}
+
+	auto loaded_debug_info = std::make_shared<AmxDebugInfo>();
+	if (!loaded_debug_info->Load(file))
+	{
+		LogManager::Get()->LogInternal(samplog::LogLevel::WARNING, fmt::format(
+			"invalid debug info in script \"{:s}\"", entry.FilePath));
+		return nullptr;
+	}
+
+	debug_info = std::move(loaded_debug_info);
+	entry.DebugInfo = debug_info;
+	return debug_info;
 }
 
-bool AmxDebugManager::GetFunctionCall(AMX * const amx, ucell address, AmxFuncCallInfo &dest)
+void AmxDebugManager::RegisterAmx(AMX *amx)
 {
 	if (_disableDebugInfo)
-		return false;
+		return;
 
-	auto it = _amxDebugMap.find(amx);
-	if (it == _amxDebugMap.end())
-		return false;
+	if (FindAmx(amx)) //amx already registered
+		return;
+
+	auto const *header = reinterpret_cast<AMX_HEADER const *>(amx->base);
+	if (header == nullptr || !IsValidHeader(*header))
+		return;
 
-	AMX_DBG *amx_dbg = it->second;
+	uint64_t const hash = GetIndexHash(amx->base);
 
+	// the scripts are indexed in the background, only wait until the
+	// script is found (or indexing is done), if a script found early on
+	// turns out to be ambiguous later, the indexing thread erases the
+	// AMX instance again
+	std::unique_lock<std::mutex> lock(_scriptsLock);
+	_scriptsIndexed.wait(lock, [this, hash]()
 	{
-		// workaround for possible overflow of amx_dbg->hdr->lines
-		// taken from Zeex' crashdetect plugin code
-		int num_lines = (
-			reinterpret_cast<unsigned char*>(amx_dbg->symboltbl[0]) -
-			reinterpret_cast<unsigned char*>(amx_dbg->linetbl)
-			) / sizeof(AMX_DBG_LINE);
-		int index = 0;
-		while (index < num_lines && amx_dbg->linetbl[index].address <= address)
-			index++;
+		return _indexingDone || _scripts.find(hash) != _scripts.end();
+	});
+
+	auto it = _scripts.find(hash);
+	if (it == _scripts.end())
+		return;
+
+	// rule out hash collisions
+	auto &entry = it->second;
+	if (entry.Ambiguous || memcmp(&entry.Header, header, sizeof(AMX_HEADER)) != 0)
+		return;
+
+	auto debug_info = LoadDebugInfo(hash, entry);
+	if (!debug_info)
+		return;
+
+	// the script lock is held until the instance is in the map, otherwise
+	// the entry could become ambiguous before the instance could be erased
+	auto instance = std::make_shared<AmxInstance>(std::move(debug_info), entry.FilePath);
+	std::lock_guard<std::mutex> map_lock(_amxDebugMapLock);
+	auto new_map = std::make_shared<AmxDebugMap>(*_amxDebugMap);
+	new_map->emplace(amx, std::move(instance));
+	std::atomic_store(&_amxDebugMap, std::shared_ptr<AmxDebugMap const>(std::move(new_map)));
+}
 
-		if (index >= num_lines)
-			return false; // invalid address
+void AmxDebugManager::EraseAmx(AMX *amx)
+{
+	if (_disableDebugInfo)
+		return;
 
-		if (--index < 0)
-			return false; // not found
+	std::shared_ptr<AmxInstance> instance;
+	{
+		std::lock_guard<std::mutex> map_lock(_amxDebugMapLock);
+		auto it = _amxDebugMap->find(amx);
+		if (it == _amxDebugMap->end())
+			return;
+
+		instance = it->second;
+		auto new_map = std::make_shared<AmxDebugMap>(*_amxDebugMap);
+		new_map->erase(amx);
+		std::atomic_store(&_amxDebugMap, std::shared_ptr<AmxDebugMap const>(std::move(new_map)));
+	}
 
-		dest.line = amx_dbg->linetbl[index].line + 1;
+	auto const &cache = instance->GetCallInfoCache();
+	if (LogConfig::Get()->GetGlobalConfig().LogMetrics
+		&& (cache.GetHits() != 0 || cache.GetMisses() != 0))
+	{
+		LogManager::Get()->LogInternal(samplog::LogLevel::DEBUG, fmt::format(
+			"call info cache of AMX {:p}: {:d} hits, {:d} misses",
+			static_cast<void *>(amx), cache.GetHits(), cache.GetMisses()));
 	}
 
-	if (dbg_LookupFile(amx_dbg, address, &(dest.file)) != AMX_ERR_NONE)
+	// the debug info is freed with the last AMX instance using it, which
+	// might be a reader still using the previous map or a queued log record
+}
+
+bool AmxDebugManager::GetFunctionCall(AMX * const amx, ucell address, AmxFuncCallInfo &dest)
+{
+	if (_disableDebugInfo)
 		return false;
 
-	if (dbg_LookupFunction(amx_dbg, address, &(dest.function)) != AMX_ERR_NONE)
+	auto const instance = FindAmx(amx);
+	if (!instance)
 		return false;
 
-	return true;
+	return instance->GetFunctionCall(address, dest);
 }
 
 bool AmxDebugManager::GetFunctionCallTrace(AMX * const amx, std::vector<AmxFuncCallInfo> &dest)
 {
-	if (_disableDebugInfo)
+	LogRecord record;
+	if (!CaptureCallTrace(amx, record))
 		return false;
 
-	if (_amxDebugMap.find(amx) != _amxDebugMap.end())
-		return false;
+	ResolveCallTrace(*record.GetAmxInstance(), record.GetAmxCodeAddresses(),
+		record.GetAmxCodeAddressCount(), dest);
+	return !dest.empty();
+}
 
-	AmxFuncCallInfo call_info;
+bool AmxDebugManager::CaptureCallTrace(AMX * const amx, LogRecord &record)
+{
+	if (_disableDebugInfo)
+		return false;
 
-	if (!GetFunctionCall(amx, amx->cip, call_info))
+	auto const instance = FindAmx(amx);
+	if (!instance)
 		return false;
 
-	dest.push_back(call_info);
+	record.SetAmxInstance(instance);
+	record.AddAmxCodeAddress(amx->cip);
 
 	AMX_HEADER *base = reinterpret_cast<AMX_HEADER *>(amx->base);
 	cell dat = reinterpret_cast<cell>(amx->base + base->dat);
@@ -190,20 +430,56 @@ bool AmxDebugManager::GetFunctionCallTrace(AMX * const amx, std::vector<AmxFuncC
 		if (ret_addr == 0)
 			break;
 
-		if (GetFunctionCall(amx, ret_addr, call_info))
-			dest.push_back(call_info);
-		else
-			dest.push_back({ 0, "<unknown>", "<unknown>" });
+		record.AddAmxCodeAddress(ret_addr);
 
 		frm_addr = *(reinterpret_cast<cell *>(dat + frm_addr));
 		if (frm_addr == 0)
 			break;
 	}
 
-	//HACK: for some reason the oldest/highest call (not cip though) 
-	//      has a slightly incorrect ret_addr
-	if (dest.size() > 1)
-		dest.back().line--;
-
 	return true;
 }
+
+std::shared_ptr<AmxInstance> AmxDebugManager::FindAmx(AMX *amx) const
+{
+	auto const map = std::atomic_load(&_amxDebugMap);
+	auto it = map->find(amx);
+	return it != map->end() ? it->second : nullptr;
+}
+
+void AmxDebugManager::ResolveCallTrace(LogRecord &record)
+{
+	if (record.GetAmxCodeAddressCount() == 0)
+		return;
+
+	std::vector<AmxFuncCallInfo> call_trace;
+	ResolveCallTrace(*record.GetAmxInstance(), record.GetAmxCodeAddresses(),
+		record.GetAmxCodeAddressCount(), call_trace);
+	record.SetCallTrace(call_trace);
+	// the AMX instance is still referenced by the record, so that
+	// the resolved names stay valid as long as the record exists
+	record.ClearAmxCodeAddresses();
+}
+
+void AmxDebugManager::ResolveCallTrace(AmxInstance &instance, std::uint32_t const *addresses,
+	size_t num_addresses, std::vector<AmxFuncCallInfo> &dest)
+{
+	ResolveAmxCallTrace(addresses, num_addresses, dest,
+		[&instance](ucell address, AmxFuncCallInfo &call_info)
+	{
+		return instance.GetFunctionCall(address, call_info);
+	});
+}
+
+
+bool AmxInstance::GetFunctionCall(ucell address, AmxFuncCallInfo &dest)
+{
+	bool found;
+	if (_callInfoCache.Get(address, found, dest))
+		return found;
+
+	found = _debugInfo->LookupFunctionCall(address, dest);
+
+	_callInfoCache.Put(address, found, dest);
+	return found;
+}
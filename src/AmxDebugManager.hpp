@@ -3,12 +3,57 @@
 #include <string>
 #include <unordered_map>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 #include "Singleton.hpp"
+#include "AmxDebugInfo.hpp"
+#include "AmxCallInfoCache.hpp"
 #include "amx/amx.h"
 #include "amx/amxdbg.h"
 #include <samplog/ILogger.hpp>
 
+class LogRecord;
+
+
+// debug state of a registered AMX instance, log records with an unresolved
+// call trace keep it alive until the logging thread resolved the trace
+class AmxInstance
+{
+public:
+	AmxInstance(std::shared_ptr<AmxDebugInfo const> debug_info, std::string script_path) :
+		_debugInfo(std::move(debug_info)),
+		_scriptPath(std::move(script_path))
+	{ }
+	~AmxInstance() = default;
+	AmxInstance(AmxInstance const &) = delete;
+	AmxInstance& operator=(AmxInstance const &) = delete;
+
+private:
+	std::shared_ptr<AmxDebugInfo const> const _debugInfo;
+	// relative to the server directory, e.g. "gamemodes/grandlarc.amx"
+	std::string const _scriptPath;
+	// lock-free, used by the threads capturing and resolving call traces
+	AmxCallInfoCache _callInfoCache;
+
+public:
+	bool GetFunctionCall(ucell address, samplog::AmxFuncCallInfo &dest);
+
+	inline AmxCallInfoCache const &GetCallInfoCache() const
+	{
+		return _callInfoCache;
+	}
+	inline AmxDebugInfo const *GetDebugInfo() const
+	{
+		return _debugInfo.get();
+	}
+	inline std::string const &GetScriptPath() const
+	{
+		return _scriptPath;
+	}
+};
 
 class AmxDebugManager : public Singleton<AmxDebugManager>
 {
@@ -18,8 +63,34 @@ private:
 	~AmxDebugManager();
 
 private:
-	bool InitDebugData(const char *filepath);
-	void InitDebugDataDir(const char *directory);
+	// a script file with debug info, indexed by the hash of its header and
+	// the tables that stay the same for loaded AMX instances
+	// the debug info itself is only loaded when a matching AMX is registered
+	// and freed again when all AMX instances using it are erased
+	struct ScriptEntry
+	{
+		ScriptEntry(AMX_HEADER const &header, std::string file_path) :
+			Header(header),
+			FilePath(std::move(file_path))
+		{ }
+
+		AMX_HEADER Header;
+		std::string FilePath;
+		// set if there are other scripts with the same index hash
+		// which can't be told apart
+		bool Ambiguous = false;
+		std::weak_ptr<AmxDebugInfo const> DebugInfo;
+	};
+
+private:
+	// runs in its own thread
+	void IndexScripts(std::vector<std::string> gamemodes);
+	bool IndexScript(const char *filepath);
+	void IndexScriptDir(const char *directory);
+	void AddScript(AMX_HEADER const &header, uint64_t hash, std::string file_path);
+	std::shared_ptr<AmxDebugInfo const> LoadDebugInfo(uint64_t hash, ScriptEntry &entry);
+	// erases all AMX instances using the debug info, the script lock has to be held
+	void EraseAmxInstances(AmxDebugInfo const *debug_info);
 
 public:
 	void RegisterAmx(AMX *amx);
@@ -28,8 +99,38 @@ public:
 	bool GetFunctionCall(AMX * const amx, ucell address, samplog::AmxFuncCallInfo &dest);
 	bool GetFunctionCallTrace(AMX * const amx, std::vector<samplog::AmxFuncCallInfo> &dest);
 
+	// only stores the raw code addresses of the current call trace in the
+	// record, returns false if there's no debug info for the AMX
+	bool CaptureCallTrace(AMX * const amx, LogRecord &record);
+	// resolves the captured code addresses of the record to its call trace,
+	// called by the logging thread, doesn't access any state of the manager
+	static void ResolveCallTrace(LogRecord &record);
+
+private:
+	// never waits for registrations, safe to call from any thread
+	std::shared_ptr<AmxInstance> FindAmx(AMX *amx) const;
+	static void ResolveCallTrace(AmxInstance &instance, std::uint32_t const *addresses,
+		size_t num_addresses, std::vector<samplog::AmxFuncCallInfo> &dest);
+
 private:
 	bool _disableDebugInfo = false;
-	std::unordered_map<AMX_HEADER *, AMX_DBG *> _availableDebugInfo;
-	std::unordered_map<AMX *, AMX_DBG *> _amxDebugMap;
+	std::thread _indexThread;
+	// guards the script index while it's being built,
+	// has to be locked before the map lock below if both are needed
+	std::mutex _scriptsLock;
+	std::condition_variable _scriptsIndexed;
+	bool _indexingDone = true;
+	std::unordered_map<uint64_t, ScriptEntry> _scripts;
+
+	// call traces are captured from any thread while AMX instances are
+	// registered and erased, the map is never modified in place but
+	// replaced by a modified copy, so readers never wait while a writer
+	// copies the map
+	// readers have to use std::atomic_load, writers hold the lock below
+	// and use std::atomic_store, both aren't lock-free for shared_ptr: the
+	// standard library briefly locks a mutex to copy the pointer
+	using AmxDebugMap = std::unordered_map<AMX *, std::shared_ptr<AmxInstance>>;
+	std::shared_ptr<AmxDebugMap const> _amxDebugMap = std::make_shared<AmxDebugMap const>();
+	// serializes modifications of the map
+	std::mutex _amxDebugMapLock;
 };
@@ -52,12 +52,17 @@ extern "C" DLL_PUBLIC samplog::internal::IApi *samplog_GetApi(int version)
 	{
 		LogConfig::Get()->Initialize();
 		LogManager::Get(); // force init
+		// has to exist before any thread asks for call traces
+		AmxDebugManager::Get();
 	}
 
 	samplog::internal::IApi *api = nullptr;
 	switch (version)
 	{
 	case 1:
+	case 2: // only appends functions to ILogger (see "since API version 2"):
+		// LogFormat, GetLogLevelMask, LogAmxFormat,
+		// RegisterNativeCallFormat and LogNativeCallFormat
 		api = new Api;
 		break;
 	default:
@@ -80,6 +85,12 @@ extern "C" DLL_PUBLIC void samplog_DestroyApi(samplog::internal::IApi *api)
 
 	if (RefCounter == 0)
 	{
+		// the script indexing thread logs its results, queued records
+		// keep the AMX instances they use alive on their own
+		AmxDebugManager::Destroy();
+		// the writer threads use the config and the log rotation, and the
+		// records of already destroyed loggers might still be queued
+		LogManager::Get()->Shutdown();
 		LogRotationManager::Destroy();
 		SampConfigReader::Destroy();
 		LogConfig::Destroy();
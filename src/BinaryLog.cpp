@@ -0,0 +1,330 @@
+#include "BinaryLog.hpp"
+#include "Timestamp.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+
+namespace
+{
+	template<typename T>
+	void WriteInteger(fmt::memory_buffer &dest, T value)
+	{
+		auto const uvalue = static_cast<uint64_t>(value);
+		char bytes[sizeof(T)];
+		for (size_t i = 0; i != sizeof(T); ++i)
+			bytes[i] = static_cast<char>((uvalue >> (i * 8)) & 0xFF);
+		dest.append(bytes, bytes + sizeof(T));
+	}
+
+	void WriteString(fmt::memory_buffer &dest, const char *str, size_t length)
+	{
+		WriteInteger<uint32_t>(dest, static_cast<uint32_t>(length));
+		dest.append(str, str + length);
+	}
+
+	void WriteString(fmt::memory_buffer &dest, const char *str)
+	{
+		WriteString(dest, str, str != nullptr ? std::strlen(str) : 0);
+	}
+}
+
+
+std::string binlog::CreateHeader(std::string const &module_name)
+{
+	fmt::memory_buffer header;
+	header.append(MAGIC, MAGIC + sizeof(MAGIC));
+	WriteInteger<uint32_t>(header, VERSION);
+	WriteString(header, module_name.data(), module_name.size());
+	return fmt::to_string(header);
+}
+
+void binlog::WriteRecord(fmt::memory_buffer &dest, LogRecord const &record,
+	std::string const &script_path)
+{
+	using samplog::LogArgument;
+	using std::chrono::duration_cast;
+	using std::chrono::nanoseconds;
+
+	WriteInteger<int64_t>(dest,
+		duration_cast<nanoseconds>(record.Time.time_since_epoch()).count());
+	WriteInteger<int64_t>(dest, duration_cast<nanoseconds>(
+		record.MonotonicTime - TimestampFormat::GetMonotonicStartTime()).count());
+	WriteInteger<uint8_t>(dest, static_cast<uint8_t>(record.Level));
+	WriteString(dest, record.GetMessage(), record.GetMessageLength());
+
+	auto const num_arguments = record.GetArgumentCount();
+	auto const *arguments = record.GetArguments();
+	const char *string_data = record.GetArgumentStringData();
+	WriteInteger<uint32_t>(dest, static_cast<uint32_t>(num_arguments));
+	for (size_t i = 0; i != num_arguments; ++i)
+	{
+		auto const &arg = arguments[i];
+		WriteInteger<uint8_t>(dest, static_cast<uint8_t>(arg.type));
+		switch (arg.type)
+		{
+		case LogArgument::Type::BOOL:
+			WriteInteger<uint8_t>(dest, arg.value.b ? 1 : 0);
+			break;
+		case LogArgument::Type::CHAR:
+			WriteInteger<uint8_t>(dest, static_cast<uint8_t>(arg.value.c));
+			break;
+		case LogArgument::Type::INT:
+			WriteInteger<int64_t>(dest, arg.value.i);
+			break;
+		case LogArgument::Type::UINT:
+			WriteInteger<uint64_t>(dest, arg.value.u);
+			break;
+		case LogArgument::Type::DOUBLE:
+		{
+			uint64_t bits;
+			static_assert(sizeof(bits) == sizeof(arg.value.d), "unexpected double size");
+			std::memcpy(&bits, &arg.value.d, sizeof(bits));
+			WriteInteger<uint64_t>(dest, bits);
+		} break;
+		case LogArgument::Type::STRING:
+			WriteString(dest, string_data, arg.value.s.length);
+			string_data += arg.value.s.length;
+			break;
+		case LogArgument::Type::POINTER:
+			WriteInteger<uint64_t>(dest, reinterpret_cast<uintptr_t>(arg.value.p));
+			break;
+		}
+	}
+
+	auto const call_trace_size = record.GetCallTraceSize();
+	auto const *call_trace = record.GetCallTrace();
+	WriteInteger<uint32_t>(dest, static_cast<uint32_t>(call_trace_size));
+	for (size_t i = 0; i != call_trace_size; ++i)
+	{
+		WriteInteger<int32_t>(dest, call_trace[i].line);
+		WriteString(dest, call_trace[i].file);
+		WriteString(dest, call_trace[i].function);
+	}
+
+	auto const num_addresses = record.GetAmxCodeAddressCount();
+	auto const *addresses = record.GetAmxCodeAddresses();
+	if (num_addresses != 0)
+		WriteString(dest, script_path.data(), script_path.size());
+	else
+		WriteString(dest, "", 0);
+	WriteInteger<uint32_t>(dest, static_cast<uint32_t>(num_addresses));
+	for (size_t i = 0; i != num_addresses; ++i)
+		WriteInteger<uint32_t>(dest, addresses[i]);
+}
+
+
+bool binlog::Reader::ReadInteger(uint64_t &dest, size_t size)
+{
+	unsigned char bytes[sizeof(uint64_t)];
+	if (!_stream.read(reinterpret_cast<char *>(bytes), size))
+		return false;
+
+	dest = 0;
+	for (size_t i = 0; i != size; ++i)
+		dest |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+	return true;
+}
+
+bool binlog::Reader::ReadString(std::string &dest)
+{
+	uint64_t length;
+	if (!ReadInteger(length, sizeof(uint32_t)) || length > MAX_STRING_LENGTH)
+		return false;
+
+	// read in chunks, so that a corrupted length can't allocate
+	// much more memory than there is data left in the stream
+	static const size_t CHUNK_SIZE = 64 * 1024;
+	dest.clear();
+	while (dest.size() != length)
+	{
+		size_t const offset = dest.size();
+		size_t const chunk_size = std::min(CHUNK_SIZE, static_cast<size_t>(length) - offset);
+		dest.resize(offset + chunk_size);
+		if (!_stream.read(&dest[offset], chunk_size))
+			return false;
+	}
+	return true;
+}
+
+bool binlog::Reader::ReadHeader(std::string &module_name, uint32_t &version)
+{
+	char magic[sizeof(MAGIC)];
+	if (!_stream.read(magic, sizeof(magic))
+		|| !std::equal(magic, magic + sizeof(magic), MAGIC))
+	{
+		return false;
+	}
+
+	uint64_t value;
+	if (!ReadInteger(value, sizeof(uint32_t)))
+		return false;
+	version = _version = static_cast<uint32_t>(value);
+
+	return ReadString(module_name);
+}
+
+bool binlog::Reader::ReadArgument(samplog::LogArgument &dest, std::string &string_data)
+{
+	using samplog::LogArgument;
+
+	uint64_t type, value;
+	if (!ReadInteger(type, sizeof(uint8_t)))
+		return false;
+
+	dest.type = static_cast<LogArgument::Type>(type);
+	switch (dest.type)
+	{
+	case LogArgument::Type::BOOL:
+		if (!ReadInteger(value, sizeof(uint8_t)))
+			return false;
+		dest.value.b = value != 0;
+		break;
+	case LogArgument::Type::CHAR:
+		if (!ReadInteger(value, sizeof(uint8_t)))
+			return false;
+		dest.value.c = static_cast<char>(value);
+		break;
+	case LogArgument::Type::INT:
+		if (!ReadInteger(value, sizeof(int64_t)))
+			return false;
+		dest.value.i = static_cast<long long>(value);
+		break;
+	case LogArgument::Type::UINT:
+		if (!ReadInteger(value, sizeof(uint64_t)))
+			return false;
+		dest.value.u = value;
+		break;
+	case LogArgument::Type::DOUBLE:
+		if (!ReadInteger(value, sizeof(uint64_t)))
+			return false;
+		std::memcpy(&dest.value.d, &value, sizeof(dest.value.d));
+		break;
+	case LogArgument::Type::STRING:
+		if (!ReadString(string_data))
+			return false;
+		// the data pointer is set by the caller
+		dest.value.s.data = nullptr;
+		dest.value.s.length = string_data.length();
+		break;
+	case LogArgument::Type::POINTER:
+		if (!ReadInteger(value, sizeof(uint64_t)))
+			return false;
+		dest.value.p = reinterpret_cast<const void *>(static_cast<uintptr_t>(value));
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+bool binlog::Reader::IsAtEnd()
+{
+	return _stream.peek() == std::istream::traits_type::eof();
+}
+
+bool binlog::Reader::ReadRecord(LogRecord &record)
+{
+	using std::chrono::duration_cast;
+	using std::chrono::nanoseconds;
+
+	uint64_t time, monotonic_time, level;
+	std::string message;
+	if (!ReadInteger(time, sizeof(int64_t))
+		|| !ReadInteger(monotonic_time, sizeof(int64_t))
+		|| !ReadInteger(level, sizeof(uint8_t))
+		|| !ReadString(message))
+	{
+		return false;
+	}
+
+	record.Time = LogRecord::Clock::time_point(duration_cast<LogRecord::Clock::duration>(
+		nanoseconds(static_cast<int64_t>(time))));
+	record.MonotonicTime = TimestampFormat::GetMonotonicStartTime()
+		+ duration_cast<LogRecord::MonotonicClock::duration>(
+			nanoseconds(static_cast<int64_t>(monotonic_time)));
+	record.Level = static_cast<samplog::LogLevel>(level);
+
+	uint64_t num_arguments = 0;
+	if (_version >= 2
+		&& (!ReadInteger(num_arguments, sizeof(uint32_t))
+			|| num_arguments > MAX_ARGUMENT_COUNT))
+	{
+		return false;
+	}
+
+	// both are allocated up front, so that the strings aren't moved anymore
+	// when taking their addresses below
+	std::vector<samplog::LogArgument> arguments(static_cast<size_t>(num_arguments));
+	std::vector<std::string> string_data(static_cast<size_t>(num_arguments));
+	for (size_t i = 0; i != arguments.size(); ++i)
+	{
+		if (!ReadArgument(arguments[i], string_data[i]))
+			return false;
+		if (arguments[i].type == samplog::LogArgument::Type::STRING)
+			arguments[i].value.s.data = string_data[i].data();
+	}
+	if (arguments.empty())
+		record.SetMessage(message);
+	else
+		record.SetFormat(message.c_str(), arguments.data(), arguments.size());
+
+	uint64_t call_trace_size;
+	if (!ReadInteger(call_trace_size, sizeof(uint32_t))
+		|| call_trace_size > MAX_CALL_TRACE_SIZE)
+	{
+		return false;
+	}
+
+	// strings are stored first, so that they're not moved anymore
+	// when taking their addresses below
+	// grown while reading, for the same reason as the strings
+	std::vector<int> lines;
+	_callTraceStrings.clear();
+	for (size_t i = 0; i != call_trace_size; ++i)
+	{
+		uint64_t line;
+		std::string file, function;
+		if (!ReadInteger(line, sizeof(int32_t))
+			|| !ReadString(file)
+			|| !ReadString(function))
+		{
+			return false;
+		}
+		lines.push_back(static_cast<int32_t>(static_cast<uint32_t>(line)));
+		_callTraceStrings.push_back(std::move(file));
+		_callTraceStrings.push_back(std::move(function));
+	}
+
+	std::vector<samplog::AmxFuncCallInfo> call_trace;
+	for (size_t i = 0; i != call_trace_size; ++i)
+	{
+		call_trace.push_back({ lines.at(i),
+			_callTraceStrings.at(i * 2).c_str(),
+			_callTraceStrings.at(i * 2 + 1).c_str() });
+	}
+	record.SetCallTrace(call_trace);
+
+	record.ClearAmxCodeAddresses();
+	_scriptPath.clear();
+	if (_version >= 2)
+	{
+		uint64_t num_addresses;
+		if (!ReadString(_scriptPath)
+			|| !ReadInteger(num_addresses, sizeof(uint32_t))
+			|| num_addresses > MAX_CALL_TRACE_SIZE)
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i != num_addresses; ++i)
+		{
+			uint64_t address;
+			if (!ReadInteger(address, sizeof(uint32_t)))
+				return false;
+			record.AddAmxCodeAddress(static_cast<uint32_t>(address));
+		}
+	}
+	return true;
+}
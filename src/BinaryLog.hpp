@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <cstdint>
+
+#include <fmt/format.h>
+
+#include "LogRecord.hpp"
+
+
+// compact binary log file format, written instead of text when a logger
+// is configured with "Format: Binary" and converted back to text by the
+// logcore-decode tool
+//
+// all integers are stored in little-endian byte order, strings are stored
+// as an uint32 length followed by the characters (not null-terminated)
+//
+// file header (written once when a new file is started):
+//   char[8]  magic "LOGCOREB"
+//   uint32   format version
+//   string   module name
+// followed by any number of records:
+//   int64    system time, in nanoseconds since the unix epoch
+//   int64    monotonic time, in nanoseconds since log-core was loaded
+//   uint8    log level
+//   string   message, or the format string if the record has arguments
+//   uint32   number of format arguments, each argument being:
+//     uint8    type (samplog::LogArgument::Type)
+//     value    uint8 for bools and chars, int64/uint64 for integers,
+//              uint64 for pointers and the IEEE 754 bits of doubles,
+//              string for strings
+//   uint32   number of call trace entries, each entry being:
+//     int32    line
+//     string   file
+//     string   function
+//   string   path of the AMX script, relative to the server directory
+//   uint32   number of AMX code addresses, each address being:
+//     uint32   the instruction pointer first, then the return addresses
+//
+// the message is formatted with its arguments and the AMX code addresses
+// are resolved with the debug info of the script when decoding, the
+// logging thread doesn't do either for binary log files
+// version 1 records have no format arguments, AMX script and addresses
+namespace binlog
+{
+	static const char MAGIC[8] = { 'L', 'O', 'G', 'C', 'O', 'R', 'E', 'B' };
+	static const uint32_t VERSION = 2;
+
+	std::string CreateHeader(std::string const &module_name);
+	// 'script_path' is the script of the AMX code addresses of the record
+	void WriteRecord(fmt::memory_buffer &dest, LogRecord const &record,
+		std::string const &script_path);
+
+	class Reader
+	{
+	public:
+		explicit Reader(std::istream &stream) :
+			_stream(stream)
+		{ }
+
+	private:
+		std::istream &_stream;
+		uint32_t _version = VERSION;
+		// storage for the call trace strings of the last read record
+		std::vector<std::string> _callTraceStrings;
+		std::string _scriptPath;
+
+		// larger sizes are only found in corrupted files
+		static const uint64_t MAX_STRING_LENGTH = 64 * 1024 * 1024;
+		static const uint64_t MAX_ARGUMENT_COUNT = 64 * 1024;
+		static const uint64_t MAX_CALL_TRACE_SIZE = 1024 * 1024;
+
+	private:
+		bool ReadInteger(uint64_t &dest, size_t size);
+		bool ReadString(std::string &dest);
+		// the data of string arguments is stored in 'string_data'
+		bool ReadArgument(samplog::LogArgument &dest, std::string &string_data);
+
+	public:
+		// returns false if the stream doesn't start with a valid header
+		bool ReadHeader(std::string &module_name, uint32_t &version);
+		// true if the stream ends exactly here, a record is expected otherwise
+		bool IsAtEnd();
+		// returns false if the record is truncated or corrupted,
+		// the call trace of 'record' is only valid until the next record is read
+		// records with format arguments still have to be formatted and
+		// AMX code addresses still have to be resolved by the caller
+		bool ReadRecord(LogRecord &record);
+		// the script of the AMX code addresses of the last read record
+		inline std::string const &GetScriptPath() const
+		{
+			return _scriptPath;
+		}
+	};
+}
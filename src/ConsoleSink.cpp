@@ -0,0 +1,91 @@
+#include "ConsoleSink.hpp"
+
+#include <cstdio>
+#include <fmt/format.h>
+
+
+ConsoleSink::ConsoleSink() :
+	_threadRunning(true),
+	_queue(QUEUE_SIZE),
+	_droppedMessages(0),
+	_threadSleeping(false)
+{
+	_thread = std::thread(&ConsoleSink::Process, this);
+}
+
+ConsoleSink::~ConsoleSink()
+{
+	_threadRunning = false;
+	NotifyThread();
+	_thread.join();
+}
+
+bool ConsoleSink::Queue(std::string &&line)
+{
+	if (!_queue.TryPush(std::move(line)))
+	{
+		++_droppedMessages;
+		return false;
+	}
+
+	// see LogManager::Queue
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_threadSleeping.load(std::memory_order_relaxed))
+		NotifyThread();
+
+	return true;
+}
+
+void ConsoleSink::NotifyThread()
+{
+	std::lock_guard<std::mutex> lg(_notifierMtx);
+	_queueNotifier.notify_one();
+}
+
+void ConsoleSink::Process()
+{
+	bool running;
+	do
+	{
+		running = _threadRunning;
+
+		while (WriteBatch())
+			;
+
+		if (running)
+			WaitForLines();
+	} while (running);
+}
+
+bool ConsoleSink::WriteBatch()
+{
+	fmt::memory_buffer batch;
+	size_t batch_size = 0;
+
+	std::string line;
+	while (batch_size != QUEUE_SIZE && _queue.TryPop(line))
+	{
+		batch.append(line.data(), line.data() + line.size());
+		++batch_size;
+	}
+
+	if (batch_size == 0)
+		return false;
+
+	std::fwrite(batch.data(), 1, batch.size(), stdout);
+	std::fflush(stdout);
+	return true;
+}
+
+void ConsoleSink::WaitForLines()
+{
+	std::unique_lock<std::mutex> lk(_notifierMtx);
+	_threadSleeping = true;
+	// pairs with the fence in Queue
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (_queue.IsEmpty() && _threadRunning)
+		_queueNotifier.wait(lk);
+
+	_threadSleeping = false;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "RingBuffer.hpp"
+
+
+// writes already rendered lines to the console from its own thread, so that
+// a slow terminal (or a full stdout pipe) doesn't stall writing the log files
+// lines are dropped instead of waiting when the console can't keep up
+class ConsoleSink
+{
+public:
+	static const size_t QUEUE_SIZE = 4096;
+
+public:
+	ConsoleSink();
+	~ConsoleSink();
+	ConsoleSink(ConsoleSink const &) = delete;
+	ConsoleSink& operator=(ConsoleSink const &) = delete;
+	ConsoleSink(ConsoleSink &&) = delete;
+	ConsoleSink& operator=(ConsoleSink &&) = delete;
+
+public:
+	// 'line' has to include the line break
+	bool Queue(std::string &&line);
+
+	inline unsigned long long GetDroppedMessageCount() const
+	{
+		return _droppedMessages;
+	}
+
+private:
+	void Process();
+	bool WriteBatch();
+	void WaitForLines();
+	void NotifyThread();
+
+private:
+	std::atomic<bool> _threadRunning;
+	std::thread _thread;
+
+	RingBuffer<std::string> _queue;
+	std::atomic<unsigned long long> _droppedMessages;
+
+	std::mutex _notifierMtx;
+	std::condition_variable _queueNotifier;
+	std::atomic<bool> _threadSleeping;
+};
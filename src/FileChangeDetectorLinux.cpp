@@ -100,9 +100,13 @@ void FileChangeDetector::EventLoop(std::string const file_path)
 		}
 
 		exit_thread = false;
-		for (int i = 0; i != length; )
+		for (int i = 0; i < length; )
 		{
+			// skip to the next event first, so that it's also done for
+			// every event which is ignored
 			struct inotify_event *event = (struct inotify_event *) &buf[i];
+			i += EVENT_SIZE + event->len;
+
 			if (event->wd < 0 || event->mask & IN_Q_OVERFLOW)
 			{
 				LogManager::Get()->LogInternal(samplog::LogLevel::WARNING, fmt::format(
@@ -138,8 +142,6 @@ void FileChangeDetector::EventLoop(std::string const file_path)
 					last_execution_tp = current_tp;
 				}
 			}
-
-			i += EVENT_SIZE + event->len;
 		}
 
 		if (exit_thread)
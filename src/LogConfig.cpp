@@ -8,6 +8,16 @@
 
 static const std::string CONFIG_FILE_NAME = "log-config.yml";
 
+// messages of the config parser, they're only logged once the config lock
+// is released, as logging a message might need the config itself
+// only accessed while the config lock is held
+static std::vector<std::pair<LogLevel, std::string>> ParserMessages;
+
+void LogParserMessage(LogLevel level, std::string message)
+{
+	ParserMessages.emplace_back(level, std::move(message));
+}
+
 LogLevel GetAllLogLevel()
 {
 	return LogLevel::DEBUG | LogLevel::INFO | LogLevel::WARNING
@@ -30,7 +40,7 @@ bool ParseLogLevel(YAML::Node const &level_node, LogLevel &dest, std::string con
 	auto const &level_str = level_node.as<std::string>(std::string());
 	if (level_str.empty())
 	{
-		LogManager::Get()->LogInternal(LogLevel::WARNING,
+		LogParserMessage(LogLevel::WARNING,
 			fmt::format("{}: invalid log level specified", error_msg));
 		return false;
 	}
@@ -38,7 +48,7 @@ bool ParseLogLevel(YAML::Node const &level_node, LogLevel &dest, std::string con
 	auto const &it = loglevel_str_map.find(level_str);
 	if (it == loglevel_str_map.end())
 	{
-		LogManager::Get()->LogInternal(LogLevel::WARNING,
+		LogParserMessage(LogLevel::WARNING,
 			fmt::format("{}: invalid log level '{}'", error_msg, level_str));
 		return false;
 	}
@@ -95,6 +105,81 @@ bool ParseFileSize(std::string const &size, unsigned int &dest_in_kb)
 	return true;
 }
 
+bool ParseFlushPolicy(YAML::Node const &policy_node, FlushPolicy &dest,
+	std::string const &error_msg)
+{
+	static const std::unordered_map<std::string, FlushPolicyType>
+		flushpolicy_type_str_map = {
+		{ "Immediate", FlushPolicyType::IMMEDIATE },
+		{ "Interval", FlushPolicyType::INTERVAL },
+		{ "Size", FlushPolicyType::SIZE },
+		{ "ErrorOnly", FlushPolicyType::ERROR_ONLY }
+	};
+
+	// policies without trigger can be specified directly
+	YAML::Node const &type = policy_node.IsMap() ? policy_node["Type"] : policy_node;
+	auto const &type_str = type.as<std::string>(std::string());
+	auto const &it = flushpolicy_type_str_map.find(type_str);
+	if (it == flushpolicy_type_str_map.end())
+	{
+		LogParserMessage(LogLevel::WARNING,
+			fmt::format("{}: invalid flush policy type '{}'", error_msg, type_str));
+		return false;
+	}
+
+	FlushPolicy policy;
+	policy.Type = it->second;
+
+	YAML::Node const &trigger = policy_node.IsMap() ? policy_node["Trigger"] : YAML::Node();
+	switch (policy.Type)
+	{
+	case FlushPolicyType::INTERVAL:
+		policy.Value = trigger.as<unsigned int>(0);
+		if (policy.Value == 0)
+		{
+			LogParserMessage(LogLevel::WARNING, fmt::format(
+				"{}: invalid interval, has to be a positive number of milliseconds",
+				error_msg));
+			return false;
+		}
+		break;
+	case FlushPolicyType::SIZE:
+	{
+		auto const size_str = trigger.as<std::string>(std::string());
+		unsigned int size_kb = 0;
+		if (!ParseFileSize(size_str, size_kb) || size_kb == 0)
+		{
+			LogParserMessage(LogLevel::WARNING, fmt::format(
+				"{}: invalid size \"{}\"", error_msg, size_str));
+			return false;
+		}
+		// buffers are written at their max. size anyway
+		auto const size = static_cast<unsigned long long>(size_kb) * 1000;
+		if (size > LogFile::MAX_BUFFER_SIZE)
+		{
+			LogParserMessage(LogLevel::WARNING, fmt::format(
+				"{}: size \"{}\" is larger than the max. buffer size of {:d} bytes, "
+				"using the max. buffer size instead",
+				error_msg, size_str, static_cast<size_t>(LogFile::MAX_BUFFER_SIZE)));
+			policy.Value = LogFile::MAX_BUFFER_SIZE;
+		}
+		else
+		{
+			policy.Value = static_cast<unsigned int>(size);
+		}
+	} break;
+	case FlushPolicyType::IMMEDIATE:
+	case FlushPolicyType::ERROR_ONLY:
+	case FlushPolicyType::DEFAULT:
+	default:
+		// no trigger needed
+		break;
+	}
+
+	dest = policy;
+	return true;
+}
+
 Logger::Config GetInternalLogConfig()
 {
 	Logger::Config config;
@@ -111,6 +196,9 @@ bool ValidateTimeFormat(std::string const &format)
 		if (format.at(idx++) != '%')
 			continue;
 
+		if (idx == format.size())
+			return false;
+
 		switch (format.at(idx++))
 		{
 		case 'a':
@@ -150,6 +238,11 @@ bool ValidateTimeFormat(std::string const &format)
 		case 'z':
 		case 'Z':
 		case '%':
+		// sub-second and monotonic time specifiers, see TimestampFormat
+		case 'L':
+		case 'f':
+		case 'N':
+		case 'K':
 			continue;
 		default:
 			return false;
@@ -178,7 +271,7 @@ void LogConfig::ParseConfigFile()
 		return;
 	}
 
-	std::lock_guard<std::mutex> lock(_configLock);
+	std::unique_lock<std::mutex> lock(_configLock);
 
 	_loggerConfigs.clear();
 
@@ -191,7 +284,7 @@ void LogConfig::ParseConfigFile()
 		auto module_name = y_it->first.as<std::string>(std::string());
 		if (module_name.empty() || module_name == "log-core")
 		{
-			LogManager::Get()->LogInternal(LogLevel::ERROR,
+			LogParserMessage(LogLevel::ERROR,
 				fmt::format("could not parse logger config: invalid logger name"));
 			continue;
 		}
@@ -242,7 +335,7 @@ void LogConfig::ParseConfigFile()
 						if (!ParseDuration(time_str, config.Rotation.Value.Date))
 						{
 							config.Rotation.Value.Date = LogRotationTimeType::DAILY;
-							LogManager::Get()->LogInternal(LogLevel::WARNING,
+							LogParserMessage(LogLevel::WARNING,
 								fmt::format(
 									"could not parse date log rotation duration " \
 									"for logger '{}': invalid duration \"{}\"",
@@ -255,7 +348,7 @@ void LogConfig::ParseConfigFile()
 						if (!ParseFileSize(size_str, config.Rotation.Value.FileSize))
 						{
 							config.Rotation.Value.FileSize = 100000; // 100MB
-							LogManager::Get()->LogInternal(LogLevel::WARNING,
+							LogParserMessage(LogLevel::WARNING,
 								fmt::format(
 									"could not parse file log rotation size " \
 									"for logger '{}': invalid size \"{}\"",
@@ -274,7 +367,7 @@ void LogConfig::ParseConfigFile()
 				}
 				else
 				{
-					LogManager::Get()->LogInternal(LogLevel::WARNING,
+					LogParserMessage(LogLevel::WARNING,
 						fmt::format(
 							"could not parse log rotation setting for logger '{}': " \
 							"invalid log rotation type '{}'",
@@ -283,7 +376,7 @@ void LogConfig::ParseConfigFile()
 			}
 			else
 			{
-				LogManager::Get()->LogInternal(LogLevel::WARNING,
+				LogParserMessage(LogLevel::WARNING,
 					fmt::format(
 						"could not parse log rotation setting for logger '{}': " \
 						"log rotation not completely specified",
@@ -291,10 +384,44 @@ void LogConfig::ParseConfigFile()
 			}
 		}
 
+		YAML::Node const &flush_policy = y_it->second["FlushPolicy"];
+		if (flush_policy)
+		{
+			ParseFlushPolicy(flush_policy, config.Flush, fmt::format(
+				"could not parse flush policy setting for logger '{}'", module_name));
+		}
+
 		YAML::Node const &console_print = y_it->second["PrintToConsole"];
 		if (console_print && console_print.IsScalar())
 			config.PrintToConsole = console_print.as<bool>(config.PrintToConsole);
 
+		YAML::Node const &file_format = y_it->second["Format"];
+		if (file_format && file_format.IsScalar())
+		{
+			static const std::unordered_map<std::string, LogFileFormat>
+				file_format_str_map = {
+				{ "Text", LogFileFormat::TEXT },
+				{ "Binary", LogFileFormat::BINARY }
+			};
+			auto const format_str = file_format.as<std::string>(std::string());
+			auto const it = file_format_str_map.find(format_str);
+			if (it != file_format_str_map.end())
+			{
+				config.Format = it->second;
+			}
+			else
+			{
+				LogParserMessage(LogLevel::WARNING, fmt::format(
+					"could not parse log file format for logger '{}': " \
+					"invalid format '{}'",
+					module_name, format_str));
+			}
+		}
+
+		YAML::Node const &string_limit = y_it->second["NativeCallStringLimit"];
+		if (string_limit && string_limit.IsScalar())
+			config.NativeCallStringLimit = string_limit.as<unsigned int>(config.NativeCallStringLimit);
+
 		YAML::Node const &append_logs = y_it->second["Append"];
 		if (append_logs && append_logs.IsScalar())
 			config.Append = append_logs.as<bool>(config.Append);
@@ -323,14 +450,15 @@ void LogConfig::ParseConfigFile()
 	YAML::Node const &logtime_format = root["LogTimeFormat"];
 	if (logtime_format && logtime_format.IsScalar())
 	{
-		auto const time_format = logtime_format.as<std::string>(_globalConfig.LogTimeFormat);
+		auto const time_format = logtime_format.as<std::string>(
+			_globalConfig.LogTimeFormat.GetFormat());
 		if (ValidateTimeFormat(time_format))
 		{
-			_globalConfig.LogTimeFormat = time_format;
+			_globalConfig.LogTimeFormat = TimestampFormat(time_format);
 		}
 		else
 		{
-			LogManager::Get()->LogInternal(LogLevel::WARNING, fmt::format(
+			LogParserMessage(LogLevel::WARNING, fmt::format(
 				"could not parse log time format: '{:s}' " \
 				"is not a valid time format string", time_format));
 		}
@@ -340,6 +468,10 @@ void LogConfig::ParseConfigFile()
 	if (enable_colors && enable_colors.IsScalar())
 		_globalConfig.EnableColors = enable_colors.as<bool>(_globalConfig.EnableColors);
 
+	YAML::Node const &log_metrics = root["LogMetrics"];
+	if (log_metrics && log_metrics.IsScalar())
+		_globalConfig.LogMetrics = log_metrics.as<bool>(_globalConfig.LogMetrics);
+
 	YAML::Node const &disable_debug = root["DisableDebugInfo"];
 	if (disable_debug && disable_debug.IsScalar())
 		_globalConfig.DisableDebugInfo = disable_debug.as<bool>(_globalConfig.DisableDebugInfo);
@@ -349,6 +481,78 @@ void LogConfig::ParseConfigFile()
 		_globalConfig.LogsRootFolder = root_folder.as<std::string>(_globalConfig.LogsRootFolder);
 	if (_globalConfig.LogsRootFolder.back() != '/')
 		_globalConfig.LogsRootFolder.push_back('/');
+
+	YAML::Node const &flush_policy = root["FlushPolicy"];
+	if (flush_policy)
+	{
+		ParseFlushPolicy(flush_policy, _globalConfig.Flush,
+			"could not parse global flush policy setting");
+	}
+
+	YAML::Node const &queue_size = root["QueueSize"];
+	if (queue_size && queue_size.IsScalar())
+	{
+		auto const size = queue_size.as<unsigned int>(0);
+		if (size != 0)
+			_globalConfig.QueueSize = size;
+		else
+			LogParserMessage(LogLevel::WARNING,
+				"could not parse queue size: has to be a positive number");
+	}
+
+	YAML::Node const &writer_threads = root["WriterThreads"];
+	if (writer_threads && writer_threads.IsScalar())
+	{
+		auto const count = writer_threads.as<unsigned int>(0);
+		if (count != 0)
+			_globalConfig.WriterThreads = count;
+		else
+			LogParserMessage(LogLevel::WARNING,
+				"could not parse writer thread count: has to be a positive number");
+	}
+
+	YAML::Node const &thread_buffer_size = root["ThreadBufferSize"];
+	if (thread_buffer_size && thread_buffer_size.IsScalar())
+	{
+		auto const size = thread_buffer_size.as<int>(-1);
+		if (size >= 0)
+			_globalConfig.ThreadBufferSize = static_cast<unsigned int>(size);
+		else
+			LogParserMessage(LogLevel::WARNING,
+				"could not parse thread buffer size: has to be zero or a positive number");
+	}
+
+	auto queue_overflow_policy = QueueOverflowPolicy::BLOCK;
+	YAML::Node const &queue_overflow = root["QueueOverflowPolicy"];
+	if (queue_overflow && queue_overflow.IsScalar())
+	{
+		static const std::unordered_map<std::string, QueueOverflowPolicy>
+			overflow_policy_str_map = {
+			{ "Block", QueueOverflowPolicy::BLOCK },
+			{ "DropNewest", QueueOverflowPolicy::DROP_NEWEST },
+			{ "DropOldest", QueueOverflowPolicy::DROP_OLDEST }
+		};
+		auto const policy_str = queue_overflow.as<std::string>(std::string());
+		auto const it = overflow_policy_str_map.find(policy_str);
+		if (it != overflow_policy_str_map.end())
+		{
+			queue_overflow_policy = it->second;
+		}
+		else
+		{
+			LogParserMessage(LogLevel::WARNING, fmt::format(
+				"could not parse queue overflow policy: invalid policy '{:s}'",
+				policy_str));
+		}
+	}
+	_queueOverflowPolicy.store(queue_overflow_policy, std::memory_order_relaxed);
+
+	std::vector<std::pair<LogLevel, std::string>> messages;
+	messages.swap(ParserMessages);
+	lock.unlock();
+
+	for (auto &message : messages)
+		LogManager::Get()->LogInternal(message.first, std::move(message.second));
 }
 
 void LogConfig::Initialize()
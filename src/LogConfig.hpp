@@ -4,12 +4,14 @@
 #include "samplog/LogLevel.hpp"
 #include "FileChangeDetector.hpp"
 #include "Logger.hpp"
+#include "Timestamp.hpp"
 
 #include <string>
 #include <map>
 #include <unordered_map>
 #include <memory>
 #include <mutex>
+#include <atomic>
 #include <functional>
 
 
@@ -21,12 +23,24 @@ struct LogLevelConfig
 	bool PrintToConsole = false;
 };
 
+enum class QueueOverflowPolicy
+{
+	BLOCK,
+	DROP_NEWEST,
+	DROP_OLDEST
+};
+
 struct GlobalConfig
 {
-	std::string LogTimeFormat = "%x %X";
+	TimestampFormat LogTimeFormat;
 	bool DisableDebugInfo = false;
 	bool EnableColors = false;
+	bool LogMetrics = false;
 	std::string LogsRootFolder = "logs/";
+	unsigned int QueueSize = 2048; // records per writer thread (about 1 KiB each), only read on startup
+	unsigned int WriterThreads = 1; // only read on startup
+	unsigned int ThreadBufferSize = 256; // per producer and writer thread, 0 to disable, only read on startup
+	FlushPolicy Flush = FlushPolicy(FlushPolicyType::IMMEDIATE);
 };
 
 class LogConfig : public Singleton<LogConfig>
@@ -45,6 +59,7 @@ private: // variables
 	std::unordered_map<std::string, ConfigUpdateEvent_t> _loggerConfigEvents;
 	std::map<LogLevel, LogLevelConfig> _levelConfigs;
 	GlobalConfig _globalConfig;
+	std::atomic<QueueOverflowPolicy> _queueOverflowPolicy{ QueueOverflowPolicy::BLOCK };
 	std::unique_ptr<FileChangeDetector> _fileWatcher;
 
 private: // functions
@@ -87,4 +102,10 @@ public: // functions
 		std::lock_guard<std::mutex> lock(_configLock);
 		return _globalConfig;
 	}
+	// doesn't lock the config, as it's needed when queueing a record,
+	// which might happen while the config is locked
+	QueueOverflowPolicy GetQueueOverflowPolicy() const
+	{
+		return _queueOverflowPolicy.load(std::memory_order_relaxed);
+	}
 };
@@ -0,0 +1,121 @@
+#include "LogFile.hpp"
+#include "utils.hpp"
+
+
+bool LogFile::EnsureOpen()
+{
+	if (_stream.is_open())
+		return true;
+
+	//create possibly non-existing folders before opening log file
+	utils::EnsureFolders(_filePath);
+	// data is already buffered by us, no need for the stream to buffer it again
+	_stream.rdbuf()->pubsetbuf(nullptr, 0);
+	_stream.open(_filePath, std::ofstream::out | std::ofstream::app);
+	if (!_stream.is_open())
+		return false;
+
+	if (!_fileHeader.empty())
+	{
+		_stream.seekp(0, std::ofstream::end);
+		if (_stream.tellp() == 0)
+			_stream.write(_fileHeader.data(), _fileHeader.size());
+	}
+	return true;
+}
+
+fmt::memory_buffer &LogFile::GetBuffer(samplog::LogLevel level)
+{
+	if (!HasBufferedData())
+	{
+		_bufferTime = Clock::now();
+		_bufferHasError = false;
+	}
+
+	if (level == samplog::LogLevel::ERROR || level == samplog::LogLevel::FATAL)
+		_bufferHasError = true;
+
+	return _buffer;
+}
+
+bool LogFile::IsBufferDue(Clock::time_point now, FlushPolicy const &default_policy)
+{
+	if (!HasBufferedData())
+		return false;
+
+	if (_buffer.size() >= MAX_BUFFER_SIZE)
+		return true;
+
+	std::lock_guard<std::mutex> lock(_lock);
+	auto const &policy = _flushPolicy.Type != FlushPolicyType::DEFAULT
+		? _flushPolicy : default_policy;
+	switch (policy.Type)
+	{
+	case FlushPolicyType::INTERVAL:
+		return now - _bufferTime >= std::chrono::milliseconds(policy.Value);
+	case FlushPolicyType::SIZE:
+		return _buffer.size() >= policy.Value;
+	case FlushPolicyType::ERROR_ONLY:
+		return _bufferHasError;
+	case FlushPolicyType::IMMEDIATE:
+	case FlushPolicyType::DEFAULT:
+	default:
+		return true;
+	}
+}
+
+LogFile::Clock::time_point LogFile::GetBufferDeadline(FlushPolicy const &default_policy)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	auto const &policy = _flushPolicy.Type != FlushPolicyType::DEFAULT
+		? _flushPolicy : default_policy;
+	if (policy.Type != FlushPolicyType::INTERVAL)
+		return Clock::time_point::max();
+
+	return _bufferTime + std::chrono::milliseconds(policy.Value);
+}
+
+void LogFile::WriteBuffer()
+{
+	if (!HasBufferedData())
+		return;
+
+	std::lock_guard<std::mutex> lock(_lock);
+	if (EnsureOpen())
+	{
+		_stream.write(_buffer.data(), _buffer.size());
+		_stream.flush();
+	}
+	_buffer.resize(0);
+
+	// reset error state, so that a temporary error (e.g. full disk)
+	// doesn't render this file unusable
+	if (!_stream)
+		_stream.clear();
+}
+
+void LogFile::Close()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	if (_stream.is_open())
+		_stream.close();
+}
+
+void LogFile::Truncate()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	if (_stream.is_open())
+		_stream.close();
+
+	utils::EnsureFolders(_filePath);
+	std::ofstream logfile(_filePath, std::ofstream::trunc);
+}
+
+void LogFile::Rotate(std::function<void()> const &action)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	if (_stream.is_open())
+		_stream.close();
+
+	action();
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <mutex>
+#include <functional>
+#include <chrono>
+
+#include <fmt/format.h>
+#include <samplog/LogLevel.hpp>
+
+
+enum class FlushPolicyType
+{
+	DEFAULT, // use global flush policy
+	IMMEDIATE,
+	INTERVAL,
+	SIZE,
+	ERROR_ONLY
+};
+
+struct FlushPolicy
+{
+	FlushPolicy() = default;
+	explicit FlushPolicy(FlushPolicyType type, unsigned int value = 0) :
+		Type(type),
+		Value(value)
+	{ }
+
+	FlushPolicyType Type = FlushPolicyType::DEFAULT;
+	unsigned int Value = 0; // milliseconds for INTERVAL, bytes for SIZE
+};
+
+enum class LogFileFormat
+{
+	TEXT,
+	BINARY
+};
+
+class LogFile
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// buffered data is always written when reaching this size,
+	// regardless of the flush policy
+	static const size_t MAX_BUFFER_SIZE = 1024 * 1024;
+
+public:
+	// 'file_header' is written at the start of every new (or empty) file
+	explicit LogFile(std::string file_path, std::string file_header = std::string()) :
+		_filePath(std::move(file_path)),
+		_fileHeader(std::move(file_header))
+	{ }
+	~LogFile() = default;
+	LogFile(LogFile const &) = delete;
+	LogFile& operator=(LogFile const &) = delete;
+	LogFile(LogFile &&) = delete;
+	LogFile& operator=(LogFile &&) = delete;
+
+private:
+	std::string const _filePath;
+	std::string const _fileHeader;
+	std::mutex _lock;
+	std::ofstream _stream;
+	FlushPolicy _flushPolicy;
+
+	// only accessed from the writer thread the file belongs to
+	// (level log files are shared, see LogManager)
+	fmt::memory_buffer _buffer;
+	Clock::time_point _bufferTime;
+	bool _bufferHasError = false;
+
+private:
+	// opens the file if it isn't open already, lock has to be held by caller
+	bool EnsureOpen();
+
+public:
+	inline std::string const &GetPath() const
+	{
+		return _filePath;
+	}
+
+	inline void SetFlushPolicy(FlushPolicy const &policy)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_flushPolicy = policy;
+	}
+
+	// data appended to the buffer is only written to the file when
+	// WriteBuffer is called, the functions below are only used by
+	// the writer thread
+	fmt::memory_buffer &GetBuffer(samplog::LogLevel level);
+	inline bool HasBufferedData() const
+	{
+		return _buffer.size() != 0;
+	}
+	// checks if the buffered data has to be written according to the flush policy
+	bool IsBufferDue(Clock::time_point now, FlushPolicy const &default_policy);
+	// returns the time the buffered data has to be written at the latest
+	Clock::time_point GetBufferDeadline(FlushPolicy const &default_policy);
+	// writes all buffered data with a single write call
+	void WriteBuffer();
+
+	void Close();
+	// creates the file if it doesn't exist and truncates its whole content
+	void Truncate();
+	// closes the file while 'action' is executed, the next write
+	// reopens the file again (used for renaming/deleting the file)
+	void Rotate(std::function<void()> const &action);
+};
@@ -13,42 +13,298 @@
 
 #include <memory>
 #include <map>
+#include <algorithm>
+#include <fmt/format.h>
 
 using samplog::LogLevel;
 
 
+namespace
+{
+	// records are processed in batches, the queue depth is reported at most
+	// once per interval (only if there were any records and "LogMetrics"
+	// is enabled)
+	const std::chrono::seconds QUEUE_METRICS_INTERVAL(10);
+
+	void AddPendingFile(std::vector<std::shared_ptr<LogFile>> &pending_files,
+		std::shared_ptr<LogFile> const &file)
+	{
+		// the shared pointer keeps the file alive until it's written,
+		// even if its logger is destroyed in the meantime
+		if (!file->HasBufferedData())
+			pending_files.push_back(file);
+	}
+
+	void WriteDueFiles(std::vector<std::shared_ptr<LogFile>> &pending_files,
+		bool force, FlushPolicy const &default_policy,
+		LogFile::Clock::time_point &next_write_time)
+	{
+		if (pending_files.empty())
+			return;
+
+		auto const now = LogFile::Clock::now();
+		auto const it = std::remove_if(pending_files.begin(), pending_files.end(),
+			[&](std::shared_ptr<LogFile> const &file)
+		{
+			if (force || file->IsBufferDue(now, default_policy))
+			{
+				file->WriteBuffer();
+				return true;
+			}
+
+			next_write_time = std::min(next_write_time, file->GetBufferDeadline(default_policy));
+			return false;
+		});
+		pending_files.erase(it, pending_files.end());
+	}
+
+	std::atomic<size_t> LastLogManagerId(0);
+}
+
+
+thread_local LogManager::Writer *LogManager::_currentWriter = nullptr;
+thread_local LogManager::ProducerThread LogManager::_producerThread;
+
+LogManager::ProducerThread::~ProducerThread()
+{
+	Close();
+}
+
+void LogManager::ProducerThread::Close()
+{
+	for (auto &buffer : Buffers)
+	{
+		if (buffer)
+			buffer->Closed.store(true, std::memory_order_release);
+	}
+	Buffers.clear();
+}
+
 LogManager::LogManager() :
 	_threadRunning(true),
-	_thread(nullptr),
+	_writersStopped(false),
+	_queueingThreads(0),
+	_id(++LastLogManagerId),
+	_threadBufferSize(LogConfig::Get()->GetGlobalConfig().ThreadBufferSize),
+	_droppedMessages(0),
+	_reportedDroppedMessages(0),
+	_reportedConsoleDroppedMessages(0),
 	_internalLogger("log-core")
 {
 	crashhandler::Install();
 
-	_thread = new std::thread(std::bind(&LogManager::Process, this));
+	auto const &global_config = LogConfig::Get()->GetGlobalConfig();
+	for (size_t i = 0; i != global_config.WriterThreads; ++i)
+		_writers.emplace_back(new Writer(i, global_config.QueueSize));
+	for (auto &writer : _writers)
+		writer->Thread = std::thread(&LogManager::Process, this, std::ref(*writer));
 }
 
 LogManager::~LogManager()
 {
+	Shutdown();
+}
+
+void LogManager::Shutdown()
+{
+	if (_writersStopped)
+		return;
+
+	// from here on only the writer threads can queue records, the records
+	// of all other threads are dropped, so that threads which keep logging
+	// can't keep the writers from running out of records
+	_threadRunning = false;
+	for (auto &writer : _writers)
 	{
-		std::lock_guard<std::mutex> lg(_queueMtx);
-		_threadRunning = false;
+		NotifyWriter(*writer);
+		writer->Thread.join();
 	}
-	_queueNotifier.notify_one();
-	_thread->join();
-	delete _thread;
+
+	// writers might have queued records for writers which were already
+	// stopped (e.g. internal log messages), process those here
+	ProcessRemainingRecords();
+
+	// other threads might still be queueing records, once they're done
+	// nothing can be queued anymore, and their records are processed too
+	_writersStopped = true;
+	while (_queueingThreads != 0)
+		std::this_thread::yield();
+	ProcessRemainingRecords();
+
+	// the internal logger is destroyed with this instance, which is after
+	// the config and log rotation singletons are gone
+	if (_internalLogger._subscribed)
+		_internalLogger.Unsubscribe();
 }
 
-void LogManager::Queue(Action_t &&action)
+void LogManager::ProcessRemainingRecords()
 {
+	bool processed;
+	do
 	{
-		std::lock_guard<std::mutex> lg(_queueMtx);
-		_queue.push(std::move(action));
+		processed = false;
+		for (auto &writer : _writers)
+		{
+			_currentWriter = writer.get();
+			processed |= ProcessBatch(*writer);
+			WritePendingFiles(*writer, true);
+		}
+	} while (processed);
+	_currentWriter = nullptr;
+}
+
+bool LogManager::Queue(LogRecord &&record)
+{
+	record.Owner->AddRef();
+
+	// checked before counting this thread too, so that Shutdown
+	// isn't kept waiting by threads which keep logging
+	if (!IsAcceptingRecords())
+	{
+		DropRecord(record);
+		return false;
 	}
-	_queueNotifier.notify_one();
+
+	++_queueingThreads;
+	bool queued = false;
+	if (!IsAcceptingRecords())
+		DropRecord(record);
+	else
+		queued = PushRecord(std::move(record));
+	--_queueingThreads;
+	return queued;
+}
+
+bool LogManager::PushRecord(LogRecord &&record)
+{
+	auto &writer = *_writers[record.Owner->_moduleNameHash % _writers.size()];
+
+	// writer threads always use the shared queues, as they must not wait
+	// for a full buffer, see below
+	ThreadBuffer *buffer = nullptr;
+	if (_threadBufferSize != 0 && _currentWriter == nullptr)
+	{
+		buffer = &GetThreadBuffer(writer);
+		if (buffer->SharedRecords.load(std::memory_order_acquire) == 0
+			&& buffer->Queue.TryPush(std::move(record)))
+		{
+			NotifyIdleWriter(writer);
+			return true;
+		}
+	}
+
+	// records which don't fit into the thread's buffer go to the shared
+	// queue, which is where the queue overflow policy applies
+	SharedRecord shared_record;
+	shared_record.Record = std::move(record);
+	shared_record.Source = buffer;
+	if (buffer != nullptr)
+		buffer->SharedRecords.fetch_add(1, std::memory_order_relaxed);
+
+	// only read once the queue is full
+	bool has_policy = false;
+	auto policy = QueueOverflowPolicy::BLOCK;
+	while (!writer.Queue.TryPush(std::move(shared_record)))
+	{
+		if (!has_policy)
+		{
+			policy = LogConfig::Get()->GetQueueOverflowPolicy();
+			// writer threads can't wait for a writer to make room in its queue,
+			// as that writer could be waiting for them too (or be the same one)
+			if (policy == QueueOverflowPolicy::BLOCK && _currentWriter != nullptr)
+				policy = QueueOverflowPolicy::DROP_NEWEST;
+			has_policy = true;
+		}
+
+		switch (policy)
+		{
+		case QueueOverflowPolicy::DROP_NEWEST:
+			DropSharedRecord(shared_record);
+			return false;
+		case QueueOverflowPolicy::DROP_OLDEST:
+		{
+			SharedRecord oldest_record;
+			if (writer.Queue.TryPop(oldest_record))
+				DropSharedRecord(oldest_record);
+		} break;
+		case QueueOverflowPolicy::BLOCK:
+		default:
+			// nothing makes room anymore once the writers are stopped
+			if (_writersStopped)
+			{
+				DropSharedRecord(shared_record);
+				return false;
+			}
+			NotifyWriter(writer);
+			std::this_thread::yield();
+			break;
+		}
+	}
+
+	NotifyIdleWriter(writer);
+	return true;
+}
+
+void LogManager::NotifyIdleWriter(Writer &writer)
+{
+	// the push has to be visible before checking if the thread is idle,
+	// otherwise the thread could go to sleep without seeing the new record
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (writer.ThreadSleeping.load(std::memory_order_relaxed))
+		NotifyWriter(writer);
+}
+
+LogManager::ThreadBuffer &LogManager::GetThreadBuffer(Writer &writer)
+{
+	auto &producer = _producerThread;
+	if (producer.ManagerId != _id)
+	{
+		// the buffers belong to a previous instance
+		producer.Close();
+		producer.ManagerId = _id;
+		producer.Buffers.resize(_writers.size());
+	}
+
+	auto &buffer = producer.Buffers[writer.Index];
+	if (!buffer)
+	{
+		buffer = std::make_shared<ThreadBuffer>(_threadBufferSize);
+
+		std::lock_guard<std::mutex> lock(writer.NewThreadBuffersLock);
+		writer.NewThreadBuffers.push_back(buffer);
+		writer.HasNewThreadBuffers.store(true, std::memory_order_release);
+	}
+	return *buffer;
+}
+
+void LogManager::NotifyWriter(Writer &writer)
+{
+	std::lock_guard<std::mutex> lg(writer.NotifierMtx);
+	writer.QueueNotifier.notify_one();
+}
+
+void LogManager::DropRecord(LogRecord &record)
+{
+	++_droppedMessages;
+	record.Owner->Release();
+}
+
+void LogManager::DropSharedRecord(SharedRecord &record)
+{
+	if (record.Source != nullptr)
+		record.Source->SharedRecords.fetch_sub(1, std::memory_order_release);
+	DropRecord(record.Record);
+}
+
+fmt::memory_buffer &LogManager::GetFileBuffer(std::shared_ptr<LogFile> const &file,
+	LogLevel level)
+{
+	AddPendingFile(_currentWriter->PendingFiles, file);
+	return file->GetBuffer(level);
 }
 
 void LogManager::WriteLevelLogString(std::string const &time, LogLevel level,
-	std::string const &module_name, std::string const &message)
+	std::string const &module_name, fmt::string_view message)
 {
 	static const std::map<LogLevel, std::string> level_files{
 		{ LogLevel::WARNING, "warnings.log" },
@@ -60,36 +316,258 @@ void LogManager::WriteLevelLogString(std::string const &time, LogLevel level,
 	if (it != level_files.end())
 	{
 		auto file_path = LogConfig::Get()->GetGlobalConfig().LogsRootFolder + it->second;
-		utils::EnsureFolders(file_path);
-		std::ofstream loglevel_file(file_path,
-			std::ofstream::out | std::ofstream::app);
-		loglevel_file <<
-			"[" << time << "] " <<
-			"[" << module_name << "] " <<
-			message << '\n' << std::flush;
+		std::lock_guard<std::mutex> lock(_levelLogFilesLock);
+		auto &loglevel_file = _levelLogFiles[level];
+		// (re)create file if logs root folder changed
+		if (!loglevel_file || loglevel_file->GetPath() != file_path)
+			loglevel_file = std::make_shared<LogFile>(file_path);
+
+		AddPendingFile(_pendingLevelLogFiles, loglevel_file);
+		fmt::format_to(loglevel_file->GetBuffer(level),
+			"[{:s}] [{:s}] {:s}\n", time, module_name, message);
+	}
+}
+
+void LogManager::Process(Writer &writer)
+{
+	_currentWriter = &writer;
+
+	bool running;
+	do
+	{
+		// remember the state before processing, so that all records queued
+		// before the thread was stopped are still processed
+		running = _threadRunning;
+
+		// all messages of a batch are written at once per file, buffered
+		// data is always written when shutting down (e.g. on a crash)
+		bool processed;
+		do
+		{
+			processed = ProcessBatch(writer);
+			WritePendingFiles(writer, !running);
+		} while (processed);
+
+		if (running)
+		{
+			if (writer.Index == 0)
+				ReportDroppedMessages();
+			ReportQueueMetrics(writer);
+			WaitForRecords(writer);
+		}
+	} while (running);
+}
+
+bool LogManager::ProcessBatch(Writer &writer)
+{
+	RemoveClosedThreadBuffers(writer);
+
+	auto queue_depth = writer.Queue.GetSize();
+	for (auto const &buffer : writer.ThreadBuffers)
+		queue_depth += buffer->Queue.GetSize();
+	if (queue_depth > writer.MaxQueueDepth)
+		writer.MaxQueueDepth = queue_depth;
+
+	// limit the batch size, otherwise nothing would be written
+	// as long as new records are queued faster than we process them
+	size_t const max_batch_size = writer.Queue.GetCapacity();
+	size_t batch_size = 0;
+
+	LogRecord record;
+	while (batch_size != max_batch_size && PopOldestRecord(writer, record))
+	{
+		// the metrics report itself doesn't count, otherwise
+		// there would always be something to report
+		if (record.Owner != &_internalLogger)
+			++writer.ProcessedRecords;
+		record.Owner->ProcessRecord(record);
+		// might delete the logger if it was destroyed already
+		record.Owner->Release();
+		++batch_size;
 	}
+	return batch_size != 0;
 }
 
-void LogManager::Process()
+void LogManager::AddNewThreadBuffers(Writer &writer)
 {
-	std::unique_lock<std::mutex> lk(_queueMtx);
+	std::lock_guard<std::mutex> lock(writer.NewThreadBuffersLock);
+	for (auto &buffer : writer.NewThreadBuffers)
+		writer.ThreadBuffers.push_back(std::move(buffer));
+	writer.NewThreadBuffers.clear();
+	writer.HasNewThreadBuffers.store(false, std::memory_order_relaxed);
+}
 
+void LogManager::RemoveClosedThreadBuffers(Writer &writer)
+{
+	// the producer thread doesn't push anything after closing its buffer
+	auto const it = std::remove_if(writer.ThreadBuffers.begin(), writer.ThreadBuffers.end(),
+		[](std::shared_ptr<ThreadBuffer> const &buffer)
+	{
+		// the shared queue might still point to the buffer
+		return buffer->Closed.load(std::memory_order_acquire)
+			&& buffer->Queue.GetFront() == nullptr
+			&& buffer->SharedRecords.load(std::memory_order_acquire) == 0;
+	});
+	writer.ThreadBuffers.erase(it, writer.ThreadBuffers.end());
+}
+
+bool LogManager::PopOldestRecord(Writer &writer, LogRecord &dest)
+{
+	// the records of every thread buffer are in order, they only
+	// have to be merged with each other and the shared queue
+	LogRecord *oldest;
+	ThreadBuffer *oldest_buffer;
+	bool rescan;
 	do
 	{
-		_queueNotifier.wait(lk);
+		// a buffer has to be known before any record its thread queued
+		// afterwards is processed
+		if (writer.HasNewThreadBuffers.load(std::memory_order_acquire))
+			AddNewThreadBuffers(writer);
+
+		oldest = nullptr;
+		oldest_buffer = nullptr;
+		for (auto const &buffer : writer.ThreadBuffers)
+		{
+			LogRecord *front = buffer->Queue.GetFront();
+			if (front != nullptr
+				&& (oldest == nullptr || front->MonotonicTime < oldest->MonotonicTime))
+			{
+				oldest = front;
+				oldest_buffer = buffer.get();
+			}
+		}
 
-		while (!_queue.empty())
+		// the thread buffers are scanned again after popping a new record
+		// from the shared queue, as everything its thread queued before
+		// (including its buffer) has to be visible when merging
+		rescan = false;
+		if (!writer.HasNextSharedRecord)
 		{
-			auto action = std::move(_queue.front());
-			_queue.pop();
-
-			//manually unlock mutex
-			//the whole write-to-file code below has no need to be locked with the
-			//message queue mutex; while writing to the log file, new messages can
-			//now be queued
-			lk.unlock();
-			action();
-			lk.lock();
+			writer.HasNextSharedRecord = writer.Queue.TryPop(writer.NextSharedRecord);
+			rescan = writer.HasNextSharedRecord;
 		}
-	} while (_threadRunning);
+	} while (rescan);
+
+	// a thread's buffered records are only older than its records in the
+	// shared queue, never newer, so the thread buffer wins if they're equal
+	auto &shared_record = writer.NextSharedRecord;
+	if (writer.HasNextSharedRecord
+		&& (oldest == nullptr || shared_record.Record.MonotonicTime < oldest->MonotonicTime))
+	{
+		dest = std::move(shared_record.Record);
+		writer.HasNextSharedRecord = false;
+		// the thread can use its buffer again once this was its last record
+		// in the shared queue, so newer records can't overtake this one
+		if (shared_record.Source != nullptr)
+			shared_record.Source->SharedRecords.fetch_sub(1, std::memory_order_release);
+		return true;
+	}
+
+	if (oldest == nullptr)
+		return false;
+
+	dest = std::move(*oldest);
+	oldest_buffer->Queue.PopFront();
+	return true;
+}
+
+bool LogManager::HasRecords(Writer &writer)
+{
+	if (writer.HasNextSharedRecord || !writer.Queue.IsEmpty()
+		|| writer.HasNewThreadBuffers.load(std::memory_order_relaxed))
+	{
+		return true;
+	}
+
+	for (auto const &buffer : writer.ThreadBuffers)
+	{
+		if (buffer->Queue.GetFront() != nullptr)
+			return true;
+	}
+	return false;
+}
+
+void LogManager::WritePendingFiles(Writer &writer, bool force)
+{
+	auto const &default_policy = LogConfig::Get()->GetGlobalConfig().Flush;
+	writer.NextWriteTime = LogFile::Clock::time_point::max();
+	WriteDueFiles(writer.PendingFiles, force, default_policy, writer.NextWriteTime);
+
+	// whichever writer comes first writes the level log files
+	std::lock_guard<std::mutex> lock(_levelLogFilesLock);
+	WriteDueFiles(_pendingLevelLogFiles, force, default_policy, writer.NextWriteTime);
+}
+
+void LogManager::WaitForRecords(Writer &writer)
+{
+	std::unique_lock<std::mutex> lk(writer.NotifierMtx);
+	writer.ThreadSleeping = true;
+	// pairs with the fence in Queue
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (!HasRecords(writer) && _threadRunning)
+	{
+		// wake up in time for buffered data which has to be written
+		if (writer.NextWriteTime != LogFile::Clock::time_point::max())
+			writer.QueueNotifier.wait_until(lk, writer.NextWriteTime);
+		else
+			writer.QueueNotifier.wait(lk);
+	}
+
+	writer.ThreadSleeping = false;
+}
+
+void LogManager::ReportQueueMetrics(Writer &writer)
+{
+	if (writer.ProcessedRecords == 0)
+		return;
+
+	auto const current_tp = std::chrono::steady_clock::now();
+	if (current_tp - writer.LastMetricsReportTime < QUEUE_METRICS_INTERVAL)
+		return;
+	writer.LastMetricsReportTime = current_tp;
+
+	if (LogConfig::Get()->GetGlobalConfig().LogMetrics)
+	{
+		LogInternal(LogLevel::DEBUG, fmt::format(
+			"writer thread {:d}: processed {:d} log messages, max. queue depth {:d}, "
+			"{:d} thread buffers",
+			writer.Index, writer.ProcessedRecords,
+			writer.MaxQueueDepth, writer.ThreadBuffers.size()));
+	}
+	writer.ProcessedRecords = 0;
+	writer.MaxQueueDepth = 0;
+}
+
+void LogManager::ReportDroppedMessages()
+{
+	auto const dropped_messages = _droppedMessages.load();
+	auto const console_dropped_messages = _consoleSink.GetDroppedMessageCount();
+	if (dropped_messages == _reportedDroppedMessages
+		&& console_dropped_messages == _reportedConsoleDroppedMessages)
+	{
+		return;
+	}
+
+	// don't spam the log-core log when the queue is constantly overflowing
+	auto const current_tp = std::chrono::steady_clock::now();
+	if (current_tp - _lastDropReportTime < std::chrono::seconds(1))
+		return;
+	_lastDropReportTime = current_tp;
+
+	if (dropped_messages != _reportedDroppedMessages)
+	{
+		LogInternal(LogLevel::WARNING, fmt::format(
+			"message queue is full, dropped {:d} log messages",
+			dropped_messages - _reportedDroppedMessages));
+		_reportedDroppedMessages = dropped_messages;
+	}
+	if (console_dropped_messages != _reportedConsoleDroppedMessages)
+	{
+		LogInternal(LogLevel::WARNING, fmt::format(
+			"console output can't keep up, dropped {:d} console messages",
+			console_dropped_messages - _reportedConsoleDroppedMessages));
+		_reportedConsoleDroppedMessages = console_dropped_messages;
+	}
 }
@@ -3,14 +3,23 @@
 #include <string>
 #include <atomic>
 #include <thread>
-#include <queue>
+#include <chrono>
 #include <mutex>
 #include <condition_variable>
 #include <fstream>
 #include <functional>
+#include <fmt/format.h>
+#include <memory>
+#include <map>
+#include <vector>
 
 #include "Singleton.hpp"
 #include "Logger.hpp"
+#include "LogFile.hpp"
+#include "RingBuffer.hpp"
+#include "SpscRingBuffer.hpp"
+#include "LogRecord.hpp"
+#include "ConsoleSink.hpp"
 
 #include <samplog/LogLevel.hpp>
 
@@ -18,9 +27,6 @@
 class LogManager : public Singleton<LogManager>
 {
 	friend class Singleton<LogManager>;
-public:
-	using Action_t = std::function<void()>;
-
 private:
 	LogManager();
 	~LogManager();
@@ -30,11 +36,40 @@ private:
 	LogManager& operator=(const LogManager&) = delete;
 
 public:
-	void Queue(Action_t &&action);
+	// stops the writer threads after all queued records are processed,
+	// has to be called before any singleton used by the writers is destroyed,
+	// records queued afterwards (or meanwhile by other threads) are dropped
+	void Shutdown();
+
+	// the record holds a reference to its logger while it's queued,
+	// which is released after it was processed or dropped
+	bool Queue(LogRecord &&record);
+
+	// returns the file's write buffer, which is written to the file after
+	// the current batch of records has been processed, unless the file's
+	// flush policy says otherwise
+	// only called from writer threads, the file belongs to the calling writer
+	fmt::memory_buffer &GetFileBuffer(std::shared_ptr<LogFile> const &file,
+		samplog::LogLevel level);
 
+	// warnings, errors and fatal errors of all loggers are
+	// also written to a log file per level
+	static inline bool HasLevelLogFile(samplog::LogLevel level)
+	{
+		return level == samplog::LogLevel::WARNING
+			|| level == samplog::LogLevel::ERROR
+			|| level == samplog::LogLevel::FATAL;
+	}
 	void WriteLevelLogString(std::string const &time,
 		samplog::LogLevel level, std::string const &module_name,
-		std::string const &message);
+		fmt::string_view message);
+
+	// the line is written by the console thread, or dropped if
+	// the console can't keep up
+	inline void PrintConsoleString(std::string &&line)
+	{
+		_consoleSink.Queue(std::move(line));
+	}
 
 	inline void LogInternal(samplog::LogLevel level, std::string msg)
 	{
@@ -42,15 +77,141 @@ public:
 	}
 
 private:
-	void Process();
+	// records of a single producer thread for a single writer, so that threads
+	// logging at high rates don't contend with each other on the writer's queue
+	struct ThreadBuffer
+	{
+		explicit ThreadBuffer(size_t size) :
+			Queue(size)
+		{ }
+
+		SpscRingBuffer<LogRecord> Queue;
+		// records of the producer thread in the writer's shared queue, which
+		// weren't processed yet, the thread doesn't use its buffer as long as
+		// there are any, so that its newer records can't overtake them
+		std::atomic<size_t> SharedRecords{ 0 };
+		// set when the producer thread exits, the buffer is
+		// released by the writer once it's empty
+		std::atomic<bool> Closed{ false };
+	};
+
+	// a record in a writer's shared queue
+	struct SharedRecord
+	{
+		LogRecord Record;
+		// buffer of the producer thread, if it has one
+		ThreadBuffer *Source = nullptr;
+	};
+
+	// the thread buffers of the calling thread, indexed by writer
+	struct ProducerThread
+	{
+		~ProducerThread();
+		void Close();
+
+		size_t ManagerId = 0;
+		std::vector<std::shared_ptr<ThreadBuffer>> Buffers;
+	};
+
+	// a writer thread with its own queue, the records of a logger are always
+	// processed by the same writer (chosen by the hash of the logger's module
+	// name, which its log file paths are made of), so that the order of each
+	// log file is kept while different log files are written in parallel
+	struct Writer
+	{
+		Writer(size_t index, size_t queue_size) :
+			Index(index),
+			Queue(queue_size),
+			LastMetricsReportTime(std::chrono::steady_clock::now())
+		{ }
+
+		size_t const Index;
+		std::thread Thread;
+		// shared by all threads without a thread buffer, and used for
+		// records which don't fit into their thread's buffer
+		RingBuffer<SharedRecord> Queue;
+		// the next record of the shared queue, only accessed from the writer
+		// thread, it's popped early to be merged with the thread buffers
+		SharedRecord NextSharedRecord;
+		bool HasNextSharedRecord = false;
+
+		// buffers of new producer threads, added by the producer threads
+		std::mutex NewThreadBuffersLock;
+		std::vector<std::shared_ptr<ThreadBuffer>> NewThreadBuffers;
+		std::atomic<bool> HasNewThreadBuffers{ false };
+		// only accessed from the writer thread
+		std::vector<std::shared_ptr<ThreadBuffer>> ThreadBuffers;
+
+		// only used to wake up the writer thread when it's idle,
+		// never locked when queueing a record to a busy thread
+		std::mutex NotifierMtx;
+		std::condition_variable QueueNotifier;
+		std::atomic<bool> ThreadSleeping{ false };
+
+		// only accessed from the writer thread
+		std::vector<std::shared_ptr<LogFile>> PendingFiles;
+		LogFile::Clock::time_point NextWriteTime;
+
+		// queue depth metrics, only accessed from the writer thread
+		size_t MaxQueueDepth = 0;
+		unsigned long long ProcessedRecords = 0;
+		std::chrono::steady_clock::time_point LastMetricsReportTime;
+	};
+
+private:
+	// all records are accepted until Shutdown is called, after that only
+	// records of the writer threads until they're stopped, as nothing
+	// would ever process the record afterwards
+	inline bool IsAcceptingRecords() const
+	{
+		return !_writersStopped && (_threadRunning || _currentWriter != nullptr);
+	}
+	bool PushRecord(LogRecord &&record);
+	void Process(Writer &writer);
+	bool ProcessBatch(Writer &writer);
+	void ProcessRemainingRecords();
+	void AddNewThreadBuffers(Writer &writer);
+	void RemoveClosedThreadBuffers(Writer &writer);
+	bool PopOldestRecord(Writer &writer, LogRecord &dest);
+	bool HasRecords(Writer &writer);
+	ThreadBuffer &GetThreadBuffer(Writer &writer);
+	void WritePendingFiles(Writer &writer, bool force);
+	void WaitForRecords(Writer &writer);
+	void NotifyWriter(Writer &writer);
+	void NotifyIdleWriter(Writer &writer);
+	void DropRecord(LogRecord &record);
+	void DropSharedRecord(SharedRecord &record);
+	void ReportDroppedMessages();
+	void ReportQueueMetrics(Writer &writer);
 
 private:
 	std::atomic<bool> _threadRunning;
-	std::thread *_thread;
+	std::atomic<bool> _writersStopped;
+	// threads currently in Queue, Shutdown waits for them to
+	// either finish queueing their record or drop it
+	std::atomic<unsigned int> _queueingThreads;
+	std::vector<std::unique_ptr<Writer>> _writers;
+	// the writer of the calling thread, nullptr for all other threads
+	static thread_local Writer *_currentWriter;
+
+	// identifies this instance in the thread local producer state,
+	// which could still be around from a previous instance
+	size_t const _id;
+	size_t const _threadBufferSize;
+	static thread_local ProducerThread _producerThread;
+
+	std::atomic<unsigned long long> _droppedMessages;
+	// only accessed from the first writer thread
+	unsigned long long _reportedDroppedMessages;
+	unsigned long long _reportedConsoleDroppedMessages;
+	std::chrono::steady_clock::time_point _lastDropReportTime;
+
+	// the level log files are written by all writers
+	std::mutex _levelLogFilesLock;
+	std::map<samplog::LogLevel, std::shared_ptr<LogFile>> _levelLogFiles;
+	std::vector<std::shared_ptr<LogFile>> _pendingLevelLogFiles;
 
-	std::mutex _queueMtx;
-	std::condition_variable _queueNotifier;
-	std::queue<Action_t> _queue;
+	ConsoleSink _consoleSink;
 
 	Logger _internalLogger;
 };
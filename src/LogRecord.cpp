@@ -0,0 +1,317 @@
+#include "LogRecord.hpp"
+
+#include <algorithm>
+#include <fmt/format.h>
+
+
+namespace
+{
+	using samplog::LogArgument;
+
+	void FormatArgument(fmt::memory_buffer &dest, std::string const &format,
+		LogArgument const &arg, const char *string_data)
+	{
+		switch (arg.type)
+		{
+		case LogArgument::Type::BOOL:
+			fmt::format_to(dest, format, arg.value.b);
+			break;
+		case LogArgument::Type::CHAR:
+			fmt::format_to(dest, format, arg.value.c);
+			break;
+		case LogArgument::Type::INT:
+			fmt::format_to(dest, format, arg.value.i);
+			break;
+		case LogArgument::Type::UINT:
+			fmt::format_to(dest, format, arg.value.u);
+			break;
+		case LogArgument::Type::DOUBLE:
+			fmt::format_to(dest, format, arg.value.d);
+			break;
+		case LogArgument::Type::STRING:
+			fmt::format_to(dest, format,
+				fmt::string_view(string_data, arg.value.s.length));
+			break;
+		case LogArgument::Type::POINTER:
+			fmt::format_to(dest, format, arg.value.p);
+			break;
+		}
+	}
+
+	// fmt can't take a runtime list of arguments, so the replacement fields
+	// are parsed here and every argument is formatted on its own
+	// supports automatic ("{}") and manual ("{0}") indexing with format specs
+	void FormatArguments(fmt::memory_buffer &dest, fmt::string_view format,
+		LogArgument const *args, const char * const *string_data, size_t num_args)
+	{
+		size_t next_arg_idx = 0;
+		std::string arg_format;
+		for (size_t i = 0; i != format.size(); ++i)
+		{
+			char const c = format.data()[i];
+			if (c == '}')
+			{
+				if (i + 1 == format.size() || format.data()[i + 1] != '}')
+					throw fmt::format_error("unmatched '}' in format string");
+				dest.push_back(c);
+				++i;
+				continue;
+			}
+			if (c != '{')
+			{
+				dest.push_back(c);
+				continue;
+			}
+			if (i + 1 != format.size() && format.data()[i + 1] == '{')
+			{
+				dest.push_back(c);
+				++i;
+				continue;
+			}
+
+			size_t field_end = i + 1;
+			while (field_end != format.size() && format.data()[field_end] != '}')
+				++field_end;
+			if (field_end == format.size())
+				throw fmt::format_error("missing '}' in format string");
+
+			std::string const field(format.data() + i + 1, field_end - i - 1);
+			auto const spec_pos = field.find(':');
+			std::string const arg_id = field.substr(0, spec_pos);
+			size_t arg_idx;
+			if (arg_id.empty())
+			{
+				arg_idx = next_arg_idx++;
+			}
+			else
+			{
+				// parsed by hand, stops as soon as the index is out of range
+				// so that huge indices can't overflow
+				arg_idx = 0;
+				for (char const digit : arg_id)
+				{
+					if (digit < '0' || digit > '9')
+						throw fmt::format_error("invalid argument index in format string");
+					if (arg_idx < num_args)
+						arg_idx = arg_idx * 10 + static_cast<size_t>(digit - '0');
+				}
+			}
+			if (arg_idx >= num_args)
+				throw fmt::format_error("argument index out of range");
+
+			arg_format = spec_pos != std::string::npos
+				? "{" + field.substr(spec_pos) + "}" : "{}";
+			FormatArgument(dest, arg_format, args[arg_idx], string_data[arg_idx]);
+			i = field_end;
+		}
+	}
+}
+
+
+LogRecord &LogRecord::operator=(LogRecord &&other)
+{
+	Owner = other.Owner;
+	Level = other.Level;
+	Time = other.Time;
+	MonotonicTime = other.MonotonicTime;
+
+	// only copy the used part of the inline buffers
+	_textLength = other._textLength;
+	_messageLength = other._messageLength;
+	if (_textLength < INLINE_MESSAGE_SIZE)
+		std::memcpy(_text, other._text, _textLength + 1);
+	else
+		_textOverflow = std::move(other._textOverflow);
+
+	_argumentCount = other._argumentCount;
+	if (_argumentCount <= INLINE_ARGUMENT_COUNT)
+		std::copy(other._arguments, other._arguments + _argumentCount, _arguments);
+	else
+		_argumentsOverflow = std::move(other._argumentsOverflow);
+
+	_callTraceSize = other._callTraceSize;
+	if (_callTraceSize <= INLINE_CALL_TRACE_SIZE)
+		std::copy(other._callTrace, other._callTrace + _callTraceSize, _callTrace);
+	else
+		_callTraceOverflow = std::move(other._callTraceOverflow);
+
+	_amxInstance = std::move(other._amxInstance);
+	_amxAddressCount = other._amxAddressCount;
+	if (_amxAddressCount <= INLINE_AMX_ADDRESS_COUNT)
+		std::copy(other._amxAddresses, other._amxAddresses + _amxAddressCount, _amxAddresses);
+	else
+		_amxAddressesOverflow = std::move(other._amxAddressesOverflow);
+
+	return *this;
+}
+
+void LogRecord::SetMessage(const char *message, size_t length)
+{
+	_textLength = _messageLength = length;
+	_argumentCount = 0;
+	if (length < INLINE_MESSAGE_SIZE)
+	{
+		std::memcpy(_text, message, length);
+		_text[length] = '\0';
+	}
+	else
+	{
+		_textOverflow.assign(message, length);
+	}
+}
+
+void LogRecord::SetFormat(const char *format,
+	samplog::LogArgument const *args, size_t num_args)
+{
+	char *string_data = PrepareFormat(format, args, num_args);
+	for (size_t i = 0; i != num_args; ++i)
+	{
+		if (args[i].type != samplog::LogArgument::Type::STRING)
+			continue;
+
+		std::memcpy(string_data, args[i].value.s.data, args[i].value.s.length);
+		string_data += args[i].value.s.length;
+	}
+}
+
+char *LogRecord::PrepareFormat(const char *format,
+	samplog::LogArgument const *args, size_t num_args)
+{
+	if (format == nullptr)
+		format = "";
+
+	size_t const format_length = std::strlen(format);
+	size_t text_length = format_length;
+	for (size_t i = 0; i != num_args; ++i)
+	{
+		if (args[i].type == samplog::LogArgument::Type::STRING)
+			text_length += args[i].value.s.length;
+	}
+
+	char *text;
+	if (text_length < INLINE_MESSAGE_SIZE)
+	{
+		text = _text;
+		text[text_length] = '\0';
+	}
+	else
+	{
+		_textOverflow.resize(text_length);
+		text = &_textOverflow[0];
+	}
+
+	samplog::LogArgument *arguments;
+	if (num_args <= INLINE_ARGUMENT_COUNT)
+	{
+		arguments = _arguments;
+	}
+	else
+	{
+		_argumentsOverflow.resize(num_args);
+		arguments = _argumentsOverflow.data();
+	}
+
+	std::memcpy(text, format, format_length);
+	for (size_t i = 0; i != num_args; ++i)
+	{
+		arguments[i] = args[i];
+		// the string data is stored after the format string in the same
+		// order as the arguments, the pointer is restored when formatting
+		if (args[i].type == samplog::LogArgument::Type::STRING)
+			arguments[i].value.s.data = nullptr;
+	}
+
+	_textLength = text_length;
+	_messageLength = format_length;
+	_argumentCount = num_args;
+	return text + format_length;
+}
+
+void LogRecord::ApplyFormat()
+{
+	if (!HasArguments())
+		return;
+
+	auto const *arguments = GetArguments();
+	const char *text = GetMessage();
+
+	std::vector<const char *> string_data(_argumentCount, nullptr);
+	const char *data = GetArgumentStringData();
+	for (size_t i = 0; i != _argumentCount; ++i)
+	{
+		if (arguments[i].type != samplog::LogArgument::Type::STRING)
+			continue;
+
+		string_data[i] = data;
+		data += arguments[i].value.s.length;
+	}
+
+	fmt::string_view const format(text, _messageLength);
+	fmt::memory_buffer message;
+	try
+	{
+		FormatArguments(message, format, arguments, string_data.data(), _argumentCount);
+	}
+	catch (fmt::format_error const &e)
+	{
+		message.resize(0);
+		fmt::format_to(message, "{:s} (invalid format: {:s})", format, e.what());
+	}
+	SetMessage(message.data(), message.size());
+}
+
+std::string LogRecord::GetFormattedMessage() const
+{
+	fmt::memory_buffer log_string_buf;
+
+	fmt::format_to(log_string_buf, "{:s}",
+		fmt::string_view(GetMessage(), GetMessageLength()));
+
+	auto const call_trace_size = GetCallTraceSize();
+	if (call_trace_size != 0)
+	{
+		auto const *call_trace = GetCallTrace();
+		fmt::format_to(log_string_buf, " (");
+		for (size_t i = 0; i != call_trace_size; ++i)
+		{
+			if (i != 0)
+				fmt::format_to(log_string_buf, " -> ");
+			fmt::format_to(log_string_buf, "{:s}:{:d}",
+				call_trace[i].file, call_trace[i].line);
+		}
+		fmt::format_to(log_string_buf, ")");
+	}
+
+	return fmt::to_string(log_string_buf);
+}
+
+void LogRecord::SetCallTrace(std::vector<samplog::AmxFuncCallInfo> const &call_trace)
+{
+	_callTraceSize = call_trace.size();
+	if (_callTraceSize <= INLINE_CALL_TRACE_SIZE)
+		std::copy(call_trace.begin(), call_trace.end(), _callTrace);
+	else
+		_callTraceOverflow = call_trace;
+}
+
+void LogRecord::AddAmxCodeAddress(std::uint32_t address)
+{
+	if (_amxAddressCount < INLINE_AMX_ADDRESS_COUNT)
+	{
+		_amxAddresses[_amxAddressCount++] = address;
+		return;
+	}
+
+	// move the inline addresses over once they don't fit anymore
+	if (_amxAddressCount == INLINE_AMX_ADDRESS_COUNT)
+	{
+		_amxAddressesOverflow.assign(_amxAddresses,
+			_amxAddresses + INLINE_AMX_ADDRESS_COUNT);
+	}
+	else
+	{
+		_amxAddressesOverflow.resize(_amxAddressCount);
+	}
+	_amxAddressesOverflow.push_back(address);
+	++_amxAddressCount;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <memory>
+
+#include <samplog/ILogger.hpp>
+
+#ifndef LOGCORE_RECORD_MESSAGE_SIZE
+#  define LOGCORE_RECORD_MESSAGE_SIZE 256
+#endif
+
+class Logger;
+class AmxInstance;
+
+
+// a single log message as it's passed from the logging function to the
+// logging thread, stored by value in the message queue
+// messages and call traces up to the inline sizes don't allocate any memory
+// messages with deferred formatting store the format string followed by
+// the data of all string arguments, and are formatted by the logging thread
+// AMX call traces are stored as raw code addresses and are resolved to
+// file names and lines by the logging thread too
+class LogRecord
+{
+public:
+	using Clock = std::chrono::system_clock;
+	using MonotonicClock = std::chrono::steady_clock;
+
+	static const size_t INLINE_MESSAGE_SIZE = LOGCORE_RECORD_MESSAGE_SIZE;
+	static const size_t INLINE_CALL_TRACE_SIZE = 8;
+	static const size_t INLINE_ARGUMENT_COUNT = 8;
+	static const size_t INLINE_AMX_ADDRESS_COUNT = 16;
+
+public:
+	LogRecord() = default;
+	~LogRecord() = default;
+	LogRecord(LogRecord &&other)
+	{
+		*this = std::move(other);
+	}
+	LogRecord &operator=(LogRecord &&other);
+	LogRecord(LogRecord const &) = delete;
+	LogRecord &operator=(LogRecord const &) = delete;
+
+public:
+	Logger *Owner = nullptr;
+	samplog::LogLevel Level = samplog::LogLevel::NONE;
+	Clock::time_point Time;
+	MonotonicClock::time_point MonotonicTime;
+
+private:
+	// message (or format string) and string arguments
+	size_t _textLength = 0;
+	char _text[INLINE_MESSAGE_SIZE];
+	std::string _textOverflow;
+	size_t _messageLength = 0;
+
+	// the data of string arguments is stored in the text buffer instead
+	size_t _argumentCount = 0;
+	samplog::LogArgument _arguments[INLINE_ARGUMENT_COUNT];
+	std::vector<samplog::LogArgument> _argumentsOverflow;
+
+	size_t _callTraceSize = 0;
+	samplog::AmxFuncCallInfo _callTrace[INLINE_CALL_TRACE_SIZE];
+	std::vector<samplog::AmxFuncCallInfo> _callTraceOverflow;
+
+	// the AMX instance is kept alive as long as the record exists, as the
+	// resolved call trace points to its debug info
+	std::shared_ptr<AmxInstance> _amxInstance;
+	size_t _amxAddressCount = 0;
+	std::uint32_t _amxAddresses[INLINE_AMX_ADDRESS_COUNT];
+	std::vector<std::uint32_t> _amxAddressesOverflow;
+
+public:
+	void SetMessage(const char *message, size_t length);
+	inline void SetMessage(std::string const &message)
+	{
+		SetMessage(message.data(), message.length());
+	}
+	inline const char *GetMessage() const
+	{
+		return _textLength < INLINE_MESSAGE_SIZE
+			? _text : _textOverflow.c_str();
+	}
+	inline size_t GetMessageLength() const
+	{
+		return _messageLength;
+	}
+
+	// stores the format string and copies of all arguments, the message
+	// is set by calling ApplyFormat later
+	void SetFormat(const char *format,
+		samplog::LogArgument const *args, size_t num_args);
+	// same as SetFormat, but the data of the string arguments isn't copied,
+	// it has to be written to the returned buffer by the caller instead,
+	// in the order of the arguments (only their lengths are used here)
+	char *PrepareFormat(const char *format,
+		samplog::LogArgument const *args, size_t num_args);
+	inline bool HasArguments() const
+	{
+		return _argumentCount != 0;
+	}
+	// the format string is the message until ApplyFormat is called
+	inline samplog::LogArgument const *GetArguments() const
+	{
+		return _argumentCount <= INLINE_ARGUMENT_COUNT
+			? _arguments : _argumentsOverflow.data();
+	}
+	inline size_t GetArgumentCount() const
+	{
+		return _argumentCount;
+	}
+	// the data of all string arguments one after another, in the order of
+	// the arguments, their data pointers aren't set in the records
+	inline const char *GetArgumentStringData() const
+	{
+		return GetMessage() + _messageLength;
+	}
+	// replaces the format string with the formatted message
+	void ApplyFormat();
+
+	// the message including the call trace, as it's written to log files
+	std::string GetFormattedMessage() const;
+
+	void SetCallTrace(std::vector<samplog::AmxFuncCallInfo> const &call_trace);
+	inline samplog::AmxFuncCallInfo const *GetCallTrace() const
+	{
+		return _callTraceSize <= INLINE_CALL_TRACE_SIZE
+			? _callTrace : _callTraceOverflow.data();
+	}
+	inline size_t GetCallTraceSize() const
+	{
+		return _callTraceSize;
+	}
+
+	// the first address is the AMX's instruction pointer,
+	// followed by the return addresses of all calling functions
+	inline void SetAmxInstance(std::shared_ptr<AmxInstance> const &instance)
+	{
+		_amxInstance = instance;
+	}
+	inline std::shared_ptr<AmxInstance> const &GetAmxInstance() const
+	{
+		return _amxInstance;
+	}
+	void AddAmxCodeAddress(std::uint32_t address);
+	inline std::uint32_t const *GetAmxCodeAddresses() const
+	{
+		return _amxAddressCount <= INLINE_AMX_ADDRESS_COUNT
+			? _amxAddresses : _amxAddressesOverflow.data();
+	}
+	inline size_t GetAmxCodeAddressCount() const
+	{
+		return _amxAddressCount;
+	}
+	inline void ClearAmxCodeAddresses()
+	{
+		_amxAddressCount = 0;
+	}
+};
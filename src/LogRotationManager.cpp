@@ -46,8 +46,8 @@ void LogRotationManager::Process()
 			std::lock_guard<std::mutex> lock(_rotationEntriesLock);
 			for (auto const &e : _rotationEntries)
 			{
-				auto const &file_path = e.first;
-				auto const &config = e.second;
+				auto &file = *e.second.File;
+				auto const &config = e.second.Config;
 
 				switch (config.Type)
 				{
@@ -56,11 +56,11 @@ void LogRotationManager::Process()
 					if (skip_date_check)
 						continue;
 
-					CheckDateRotation(file_path, config.Value.Date, config.BackupCount);
+					CheckDateRotation(file, config.Value.Date, config.BackupCount);
 					break;
 
 				case LogRotationType::SIZE:
-					CheckSizeRotation(file_path, config.Value.FileSize, config.BackupCount);
+					CheckSizeRotation(file, config.Value.FileSize, config.BackupCount);
 					break;
 				case LogRotationType::NONE:
 				default:
@@ -80,9 +80,10 @@ void SplitFilePath(std::string const &file_path, std::string &file_dir, std::str
 	file_name = file_path.substr(filepath_offset + 1);
 }
 
-void LogRotationManager::CheckDateRotation(std::string const &file_path,
+void LogRotationManager::CheckDateRotation(LogFile &log_file,
 	LogRotationTimeType const time_type, int const backup_count)
 {
+	auto const &file_path = log_file.GetPath();
 	std::string file_dir, file_name;
 	SplitFilePath(file_path, file_dir, file_name);
 
@@ -159,18 +160,23 @@ void LogRotationManager::CheckDateRotation(std::string const &file_path,
 
 	if (backup_count != 0)
 	{
-		std::rename(file_path.c_str(), new_filename.c_str());
+		// log file has to be closed while being renamed
+		log_file.Rotate([&file_path, &new_filename]()
+		{
+			std::rename(file_path.c_str(), new_filename.c_str());
+		});
 	}
 	else
 	{
 		// clear original file, because the number of backups to keep is zero
-		std::ofstream logfile(file_path, std::ofstream::trunc);
+		log_file.Truncate();
 	}
 }
 
-void LogRotationManager::CheckSizeRotation(std::string const &file_path,
+void LogRotationManager::CheckSizeRotation(LogFile &log_file,
 	unsigned int const max_size, int const backup_count)
 {
+	auto const &file_path = log_file.GetPath();
 	std::string file_dir, file_name;
 	SplitFilePath(file_path, file_dir, file_name);
 
@@ -252,11 +258,15 @@ void LogRotationManager::CheckSizeRotation(std::string const &file_path,
 
 	if (backup_count != 0)
 	{
-		std::rename(file_path.c_str(), filename_count(1).c_str());
+		// log file has to be closed while being renamed
+		log_file.Rotate([&file_path, &filename_count]()
+		{
+			std::rename(file_path.c_str(), filename_count(1).c_str());
+		});
 	}
 	else
 	{
 		// clear original file, because the number of backups to keep is zero
-		std::ofstream logfile(file_path, std::ofstream::trunc);
+		log_file.Truncate();
 	}
 }
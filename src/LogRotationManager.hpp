@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Singleton.hpp"
+#include "LogFile.hpp"
 
 #include <string>
 #include <unordered_map>
@@ -41,9 +42,16 @@ private:
 	LogRotationManager();
 	~LogRotationManager();
 
+private:
+	struct RotationEntry
+	{
+		LogFile *File;
+		LogRotationConfig Config;
+	};
+
 private:
 	std::mutex _rotationEntriesLock;
-	std::unordered_map<std::string, LogRotationConfig> _rotationEntries;
+	std::unordered_map<std::string, RotationEntry> _rotationEntries;
 
 	std::atomic<bool> _threadRunning;
 	std::thread _thread;
@@ -51,22 +59,22 @@ private:
 private:
 	void Process();
 
-	void CheckDateRotation(std::string const &file_path,
+	void CheckDateRotation(LogFile &file,
 		LogRotationTimeType const type, int const backup_count);
-	void CheckSizeRotation(std::string const &file_path,
+	void CheckSizeRotation(LogFile &file,
 		unsigned int const max_size, int const backup_count);
 
 public:
-	inline void RegisterLogFile(std::string const &file_path,
+	inline void RegisterLogFile(LogFile &file,
 		LogRotationConfig const &config)
 	{
 		std::lock_guard<std::mutex> lock(_rotationEntriesLock);
-		auto it = _rotationEntries.find(file_path);
+		auto it = _rotationEntries.find(file.GetPath());
 		if (it != _rotationEntries.end())
-			_rotationEntries.erase(file_path);
+			_rotationEntries.erase(file.GetPath());
 
 		if (config.Type != LogRotationType::NONE)
-			_rotationEntries.emplace(file_path, config);
+			_rotationEntries.emplace(file.GetPath(), RotationEntry{ &file, config });
 	}
 	inline void UnregisterLogFile(std::string const &file_path)
 	{
@@ -2,40 +2,60 @@
 #include "AmxDebugManager.hpp"
 #include "LogManager.hpp"
 #include "LogConfig.hpp"
-#include "amx/amx2.h"
+#include "BinaryLog.hpp"
 #include "utils.hpp"
 
 #include <fmt/format.h>
-#include <fmt/time.h>
-#include <ctime>
+#include <cstring>
 
 
 Logger::Logger(std::string module_name) :
 	_moduleName(std::move(module_name)),
-	_logFilePath(LogConfig::Get()->GetGlobalConfig().LogsRootFolder + _moduleName + ".log"),
-	_logCounter(0)
+	_moduleNameHash(std::hash<std::string>()(_moduleName)),
+	_logFile(std::make_shared<LogFile>(
+		LogConfig::Get()->GetGlobalConfig().LogsRootFolder + _moduleName + ".log")),
+	_binaryLogFile(std::make_shared<LogFile>(
+		LogConfig::Get()->GetGlobalConfig().LogsRootFolder + _moduleName + ".bin",
+		binlog::CreateHeader(_moduleName))),
+	_refCount(1),
+	_logLevelMask(static_cast<int>(_config.Level)),
+	_nativeCallStringLimit(_config.NativeCallStringLimit)
 {
-	//create possibly non-existing folders before opening log file
-	utils::EnsureFolders(_logFilePath);
-
 	LogConfig::Get()->SubscribeLogger(this,
 		std::bind(&Logger::OnConfigUpdate, this, std::placeholders::_1));
 	if (_config.Append == false)
-	{
-		// create file if it doesn't exist, and truncate whole content
-		std::ofstream logfile(_logFilePath, std::ofstream::trunc);
-	}
+		GetLogFile()->Truncate();
 }
 
 Logger::~Logger()
 {
-	LogConfig::Get()->UnsubscribeLogger(this);
-	LogRotationManager::Get()->UnregisterLogFile(_logFilePath);
+	// loggers which aren't created by the API (like the internal logger)
+	// are never destroyed through Destroy, and don't have any records left
+	if (_subscribed)
+		Unsubscribe();
+}
 
-	// wait until all log messages are processed, as we have this logger
-	// referenced in the action lambda and deleting it would be bad
-	while (_logCounter != 0)
-		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+void Logger::Destroy()
+{
+	// done here instead of in the destructor, which usually runs on the
+	// writer thread, so that config updates and log rotations don't race
+	// with the logger's deletion
+	Unsubscribe();
+	Release();
+}
+
+void Logger::Release()
+{
+	if (_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		delete this;
+}
+
+void Logger::Unsubscribe()
+{
+	LogConfig::Get()->UnsubscribeLogger(this);
+	LogRotationManager::Get()->UnregisterLogFile(_logFile->GetPath());
+	LogRotationManager::Get()->UnregisterLogFile(_binaryLogFile->GetPath());
+	_subscribed = false;
 }
 
 bool Logger::Log(LogLevel level, std::string msg,
@@ -44,25 +64,15 @@ bool Logger::Log(LogLevel level, std::string msg,
 	if (!IsLogLevel(level))
 		return false;
 
-	auto current_time = Clock::now();
-	LogManager::Get()->Queue([this, level, current_time, msg, call_info]()
-	{
-		std::string const
-			time_str = FormatTimestamp(current_time),
-			log_msg = FormatLogMessage(msg, call_info);
-
-		WriteLogString(time_str, level, log_msg);
-		LogManager::Get()->WriteLevelLogString(time_str, level, GetModuleName(), msg);
-
-		auto const &level_config = LogConfig::Get()->GetLogLevelConfig(level);
-		if (_config.PrintToConsole || level_config.PrintToConsole)
-			PrintLogString(time_str, level, log_msg);
-
-		--_logCounter;
-	});
+	LogRecord record;
+	record.Owner = this;
+	record.Level = level;
+	record.Time = Clock::now();
+	record.MonotonicTime = LogRecord::MonotonicClock::now();
+	record.SetMessage(msg);
+	record.SetCallTrace(call_info);
 
-	++_logCounter;
-	return true;
+	return LogManager::Get()->Queue(std::move(record));
 }
 
 bool Logger::Log(LogLevel level, std::string msg)
@@ -71,145 +81,209 @@ bool Logger::Log(LogLevel level, std::string msg)
 	return Log(level, std::move(msg), empty_call_info);
 }
 
-bool Logger::LogNativeCall(AMX * const amx, cell * const params,
-	std::string name, std::string params_format)
+bool Logger::LogFormat(LogLevel level, const char *format,
+	samplog::LogArgument const *args, size_t num_args,
+	std::vector<samplog::AmxFuncCallInfo> const &call_info)
+{
+	if (!IsLogLevel(level))
+		return false;
+
+	LogRecord record;
+	record.Owner = this;
+	record.Level = level;
+	record.Time = Clock::now();
+	record.MonotonicTime = LogRecord::MonotonicClock::now();
+	record.SetFormat(format, args, num_args);
+	record.SetCallTrace(call_info);
+
+	return LogManager::Get()->Queue(std::move(record));
+}
+
+bool Logger::LogAmxFormat(AMX * const amx, LogLevel level, const char *format,
+	samplog::LogArgument const *args, size_t num_args)
 {
 	if (amx == nullptr)
 		return false;
 
-	if (params == nullptr)
+	if (!IsLogLevel(level))
+		return false;
+
+	LogRecord record;
+	if (!AmxDebugManager::Get()->CaptureCallTrace(amx, record))
 		return false;
 
+	record.Owner = this;
+	record.Level = level;
+	record.Time = Clock::now();
+	record.MonotonicTime = LogRecord::MonotonicClock::now();
+	if (num_args == 0)
+	{
+		const char *message = format != nullptr ? format : "";
+		record.SetMessage(message, std::strlen(message));
+	}
+	else
+		record.SetFormat(format, args, num_args);
+
+	return LogManager::Get()->Queue(std::move(record));
+}
+
+bool Logger::LogNativeCall(AMX * const amx, cell * const params,
+	std::string name, std::string params_format)
+{
 	if (name.empty())
 		return false;
 
 	if (!IsLogLevel(LogLevel::DEBUG))
 		return false;
 
+	samplog::NativeCallFormat format;
+	if (!format.Compile(name.c_str(), params_format.c_str()))
+		return false;
 
-	fmt::memory_buffer fmt_msg;
+	return LogNativeCallFormat(amx, params, &format);
+}
 
-	fmt::format_to(fmt_msg, "{:s}(", name);
+samplog::NativeCallFormat const *Logger::RegisterNativeCallFormat(const char *name,
+	const char *params_format)
+{
+	if (name == nullptr || *name == '\0' || params_format == nullptr)
+		return nullptr;
 
-	for (size_t i = 0; i != params_format.length(); ++i)
-	{
-		if (i != 0)
-			fmt::format_to(fmt_msg, ", ");
-
-		cell current_param = params[i + 1];
-		switch (params_format[i])
-		{
-		case 'd': //decimal
-		case 'i': //integer
-			fmt::format_to(fmt_msg, "{:d}", static_cast<int>(current_param));
-			break;
-		case 'f': //float
-			fmt::format_to(fmt_msg, "{:f}", amx_ctof(current_param));
-			break;
-		case 'h': //hexadecimal
-		case 'x': //
-			fmt::format_to(fmt_msg, "{:x}", current_param);
-			break;
-		case 'b': //binary
-			fmt::format_to(fmt_msg, "{:b}", current_param);
-			break;
-		case 's': //string
-			fmt::format_to(fmt_msg, "\"{:s}\"", amx_GetCppString(amx, current_param));
-			break;
-		case '*': //censored output
-			fmt::format_to(fmt_msg, "\"*****\"");
-			break;
-		case 'r': //reference
-		{
-			cell *addr_dest = nullptr;
-			amx_GetAddr(amx, current_param, &addr_dest);
-			fmt::format_to(fmt_msg, "{:#08x}", reinterpret_cast<unsigned int>(addr_dest));
-		}	break;
-		case 'p': //pointer-value
-			fmt::format_to(fmt_msg, "{:#08x}", current_param);
-			break;
-		default:
-			return false; //unrecognized format specifier
-		}
-	}
-	fmt::format_to(fmt_msg, ")");
+	std::unique_ptr<samplog::NativeCallFormat> format(new samplog::NativeCallFormat);
+	if (!format->Compile(name, params_format))
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock(_nativeCallFormatsLock);
+	_nativeCallFormats.push_back(std::move(format));
+	return _nativeCallFormats.back().get();
+}
+
+bool Logger::LogNativeCallFormat(AMX * const amx, cell * const params,
+	samplog::NativeCallFormat const *format)
+{
+	if (amx == nullptr)
+		return false;
 
-	std::vector<samplog::AmxFuncCallInfo> call_info;
-	AmxDebugManager::Get()->GetFunctionCallTrace(amx, call_info);
+	if (params == nullptr)
+		return false;
 
-	return Log(LogLevel::DEBUG, fmt::to_string(fmt_msg), call_info);
+	if (format == nullptr)
+		return false;
+
+	if (!IsLogLevel(LogLevel::DEBUG))
+		return false;
+
+	LogRecord record;
+	record.Owner = this;
+	record.Level = LogLevel::DEBUG;
+	record.Time = Clock::now();
+	record.MonotonicTime = LogRecord::MonotonicClock::now();
+	format->Capture(amx, params,
+		_nativeCallStringLimit.load(std::memory_order_relaxed), record);
+	// the call trace is optional here
+	AmxDebugManager::Get()->CaptureCallTrace(amx, record);
+
+	return LogManager::Get()->Queue(std::move(record));
 }
 
 void Logger::OnConfigUpdate(Logger::Config const &config)
 {
 	_config = config;
-	LogRotationManager::Get()->RegisterLogFile(_logFilePath, _config.Rotation);
+	_logLevelMask = static_cast<int>(_config.Level);
+	_nativeCallStringLimit = _config.NativeCallStringLimit;
+	// settings might have changed, reopen log files on next write
+	for (auto const &file : { _logFile, _binaryLogFile })
+	{
+		file->Close();
+		file->SetFlushPolicy(_config.Flush);
+		if (file == GetLogFile())
+			LogRotationManager::Get()->RegisterLogFile(*file, _config.Rotation);
+		else
+			LogRotationManager::Get()->UnregisterLogFile(file->GetPath());
+	}
 }
 
-std::string Logger::FormatTimestamp(Clock::time_point time)
+std::string const &Logger::FormatTimestamp(LogRecord const &record)
 {
-	std::time_t now_c = std::chrono::system_clock::to_time_t(time);
-	auto const &time_format = LogConfig::Get()->GetGlobalConfig().LogTimeFormat;
-	return fmt::format("{:" + time_format + "}", fmt::localtime(now_c));
+	return _timestampCache.Get(LogConfig::Get()->GetGlobalConfig().LogTimeFormat,
+		record.Time, record.MonotonicTime);
 }
 
-std::string Logger::FormatLogMessage(std::string message,
-	std::vector<samplog::AmxFuncCallInfo> call_info)
+void Logger::ProcessRecord(LogRecord &record)
 {
-	fmt::memory_buffer log_string_buf;
+	auto const &level_config = LogConfig::Get()->GetLogLevelConfig(record.Level);
+	bool const print_to_console = _config.PrintToConsole || level_config.PrintToConsole;
+
+	// binary log files store the format arguments and the AMX code addresses
+	// as they are, they're formatted and resolved by logcore-decode, so that's
+	// only done here if the record is also written as text
+	if (_config.Format == LogFileFormat::BINARY)
+	{
+		static const std::string no_script_path;
+		auto const &amx_instance = record.GetAmxInstance();
+		binlog::WriteRecord(
+			LogManager::Get()->GetFileBuffer(_binaryLogFile, record.Level), record,
+			amx_instance ? amx_instance->GetScriptPath() : no_script_path);
+
+		if (!print_to_console && !LogManager::HasLevelLogFile(record.Level))
+			return;
+	}
 
-	fmt::format_to(log_string_buf, "{:s}", message);
+	// messages with deferred formatting are formatted here,
+	// instead of in the thread calling the logging function
+	record.ApplyFormat();
+	// same for the symbol lookups of captured AMX call traces
+	AmxDebugManager::ResolveCallTrace(record);
 
-	if (!call_info.empty())
+	std::string const &time_str = FormatTimestamp(record);
+	std::string log_msg;
+	if (_config.Format != LogFileFormat::BINARY)
 	{
-		fmt::format_to(log_string_buf, " (");
-		bool first = true;
-		for (auto const &ci : call_info)
-		{
-			if (!first)
-				fmt::format_to(log_string_buf, " -> ");
-			fmt::format_to(log_string_buf, "{:s}:{:d}", ci.file, ci.line);
-			first = false;
-		}
-		fmt::format_to(log_string_buf, ")");
+		log_msg = record.GetFormattedMessage();
+		WriteLogString(time_str, record.Level, log_msg);
 	}
 
-	return fmt::to_string(log_string_buf);
+	LogManager::Get()->WriteLevelLogString(time_str, record.Level, GetModuleName(),
+		fmt::string_view(record.GetMessage(), record.GetMessageLength()));
+
+	if (print_to_console)
+	{
+		if (_config.Format == LogFileFormat::BINARY)
+			log_msg = record.GetFormattedMessage();
+		PrintLogString(time_str, record.Level, log_msg);
+	}
 }
 
 void Logger::WriteLogString(std::string const &time, LogLevel level, std::string const &message)
 {
-	utils::EnsureFolders(_logFilePath);
-	std::ofstream logfile(_logFilePath,
-		std::ofstream::out | std::ofstream::app);
-	logfile <<
-		"[" << time << "] " <<
-		"[" << utils::GetLogLevelAsString(level) << "] " <<
-		message << '\n' << std::flush;
+	fmt::format_to(LogManager::Get()->GetFileBuffer(_logFile, level),
+		"[{:s}] [{:s}] {:s}\n", time, utils::GetLogLevelAsString(level), message);
 }
 
 void Logger::PrintLogString(std::string const &time, LogLevel level, std::string const &message)
 {
+	// the whole line is rendered into one string, which is written
+	// to the console with a single call by the console thread
 	auto *loglevel_str = utils::GetLogLevelAsString(level);
+	std::string line;
 	if (LogConfig::Get()->GetGlobalConfig().EnableColors)
 	{
 		utils::EnsureTerminalColorSupport();
 
-		fmt::print("[");
-		fmt::print(fmt::fg(fmt::rgb(255, 255, 150)), time);
-		fmt::print("] [");
-		fmt::print(fmt::fg(fmt::color::sandy_brown), GetModuleName());
-		fmt::print("] [");
 		auto loglevel_color = utils::GetLogLevelColor(level);
-		if (level == LogLevel::FATAL)
-			fmt::print(fmt::fg(fmt::color::white) | fmt::bg(loglevel_color), loglevel_str);
-		else
-			fmt::print(fmt::fg(loglevel_color), loglevel_str);
-		fmt::print("] {:s}\n", message);
+		auto const loglevel_style = level == LogLevel::FATAL
+			? fmt::fg(fmt::color::white) | fmt::bg(loglevel_color)
+			: fmt::fg(loglevel_color);
+		line = fmt::format("[{:s}] [{:s}] [{:s}] {:s}\n",
+			fmt::format(fmt::fg(fmt::rgb(255, 255, 150)), "{:s}", time),
+			fmt::format(fmt::fg(fmt::color::sandy_brown), "{:s}", GetModuleName()),
+			fmt::format(loglevel_style, "{:s}", loglevel_str),
+			message);
 	}
 	else
 	{
-		fmt::print("[{:s}] [{:s}] [{:s}] {:s}\n",
+		line = fmt::format("[{:s}] [{:s}] [{:s}] {:s}\n",
 			time, GetModuleName(), loglevel_str, message);
 	}
+	LogManager::Get()->PrintConsoleString(std::move(line));
 }
@@ -3,18 +3,26 @@
 #include <string>
 #include <chrono>
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include <samplog/export.h>
 #include <samplog/ILogger.hpp>
 #include "LogRotationManager.hpp"
+#include "LogFile.hpp"
+#include "LogRecord.hpp"
+#include "NativeCallFormat.hpp"
+#include "Timestamp.hpp"
 
 using samplog::LogLevel;
 
 
 class Logger : public samplog::ILogger
 {
+	friend class LogManager;
 public:
-	using Clock = std::chrono::system_clock;
+	using Clock = LogRecord::Clock;
 
 	struct Config
 	{
@@ -22,6 +30,11 @@ public:
 		bool PrintToConsole = false;
 		bool Append = true;
 		LogRotationConfig Rotation;
+		FlushPolicy Flush;
+		LogFileFormat Format = LogFileFormat::TEXT;
+		// max. number of characters of string parameters logged by
+		// LogNativeCall, longer strings are truncated, 0 for no limit
+		unsigned int NativeCallStringLimit = 256;
 	};
 
 public:
@@ -31,7 +44,11 @@ public:
 public: // interface implementation
 	bool IsLogLevel(LogLevel log_level) const override
 	{
-		return (_config.Level & log_level) == log_level;
+		return (_logLevelMask.load(std::memory_order_relaxed) & log_level) == log_level;
+	}
+	std::atomic<int> const *GetLogLevelMask() const override
+	{
+		return &_logLevelMask;
 	}
 
 	bool Log(LogLevel level, std::string msg,
@@ -39,11 +56,19 @@ public: // interface implementation
 	bool Log(LogLevel level, std::string msg) override;
 	bool LogNativeCall(AMX * const amx, cell * const params,
 		std::string name, std::string params_format) override;
+	bool LogFormat(LogLevel level, const char *format,
+		samplog::LogArgument const *args, size_t num_args,
+		std::vector<samplog::AmxFuncCallInfo> const &call_info) override;
+	bool LogAmxFormat(AMX * const amx, LogLevel level, const char *format,
+		samplog::LogArgument const *args, size_t num_args) override;
+	samplog::NativeCallFormat const *RegisterNativeCallFormat(const char *name,
+		const char *params_format) override;
+	bool LogNativeCallFormat(AMX * const amx, cell * const params,
+		samplog::NativeCallFormat const *format) override;
 
-	void Destroy() override
-	{
-		delete this;
-	}
+	// returns immediately, the logger is deleted by its writer thread
+	// after its last queued record was processed
+	void Destroy() override;
 
 public:
 	inline std::string const &GetModuleName() const
@@ -52,11 +77,27 @@ public:
 	}
 
 private:
+	// every queued record holds a reference, as well as the owner
+	// of the logger until it's destroyed
+	inline void AddRef()
+	{
+		_refCount.fetch_add(1, std::memory_order_relaxed);
+	}
+	void Release();
+
+	void Unsubscribe();
 	void OnConfigUpdate(Logger::Config const &config);
 
-	std::string FormatTimestamp(Clock::time_point time);
-	std::string FormatLogMessage(std::string message,
-		std::vector<samplog::AmxFuncCallInfo> call_info);
+	// called from the writer thread of this logger
+	void ProcessRecord(LogRecord &record);
+
+	// the log file used by the configured file format
+	inline std::shared_ptr<LogFile> const &GetLogFile() const
+	{
+		return _config.Format == LogFileFormat::BINARY ? _binaryLogFile : _logFile;
+	}
+
+	std::string const &FormatTimestamp(LogRecord const &record);
 
 	void WriteLogString(std::string const &time, LogLevel level,
 		std::string const &message);
@@ -65,8 +106,21 @@ private:
 
 private:
 	std::string const _moduleName;
-	std::string const _logFilePath;
-	std::atomic<unsigned int> _logCounter;
+	// selects the writer thread processing the records of this logger
+	size_t const _moduleNameHash;
+	std::shared_ptr<LogFile> const _logFile;
+	std::shared_ptr<LogFile> const _binaryLogFile;
+	std::atomic<unsigned int> _refCount;
+	bool _subscribed = true; // only accessed by the owner of the logger
 
 	Config _config;
+	// copy of the configured log level, can be read from any thread
+	std::atomic<int> _logLevelMask;
+	// same for the native call string limit
+	std::atomic<unsigned int> _nativeCallStringLimit;
+	TimestampCache _timestampCache; // only used by the writer thread
+
+	// registered native call formats, never removed so the handles stay valid
+	std::mutex _nativeCallFormatsLock;
+	std::vector<std::unique_ptr<samplog::NativeCallFormat>> _nativeCallFormats;
 };
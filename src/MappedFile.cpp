@@ -0,0 +1,79 @@
+#ifdef WIN32
+#  include <Windows.h>
+#else
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include "MappedFile.hpp"
+
+
+bool MappedFile::Open(std::string const &file_path)
+{
+	Close();
+
+#ifdef WIN32
+	HANDLE file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL)
+		return false;
+
+	// the view keeps the mapping alive
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (data == NULL)
+		return false;
+
+	_size = static_cast<size_t>(file_size.QuadPart);
+#else
+	int fd = open(file_path.c_str(), O_RDONLY);
+	if (fd == -1)
+		return false;
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	// the mapping stays valid after closing the file
+	void *data = mmap(nullptr, static_cast<size_t>(file_stat.st_size),
+		PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	_size = static_cast<size_t>(file_stat.st_size);
+#endif
+	_data = static_cast<unsigned char const *>(data);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (_data == nullptr)
+		return;
+
+#ifdef WIN32
+	UnmapViewOfFile(_data);
+#else
+	munmap(const_cast<unsigned char *>(_data), _size);
+#endif
+	_data = nullptr;
+	_size = 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+
+// read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile()
+	{
+		Close();
+	}
+	MappedFile(MappedFile const &) = delete;
+	MappedFile& operator=(MappedFile const &) = delete;
+
+private:
+	unsigned char const *_data = nullptr;
+	size_t _size = 0;
+
+public:
+	// fails for empty files
+	bool Open(std::string const &file_path);
+	void Close();
+
+	inline unsigned char const *GetData() const
+	{
+		return _data;
+	}
+	inline size_t GetSize() const
+	{
+		return _size;
+	}
+};
@@ -0,0 +1,222 @@
+#include "NativeCallFormat.hpp"
+#include "LogRecord.hpp"
+#include "amx/amx.h"
+
+#include <cstring>
+#include <limits>
+
+
+namespace
+{
+	// appended to truncated string parameters
+	const char TRUNCATION_MARKER[] = "...";
+
+	// AMX strings are either unpacked (one character per cell) or packed
+	// (one character per byte, starting at the most significant byte)
+	inline bool IsPackedString(cell const *str)
+	{
+		return static_cast<ucell>(*str) > UNPACKEDMAX;
+	}
+
+	inline char GetPackedChar(cell const *str, size_t idx)
+	{
+		return static_cast<char>(static_cast<ucell>(str[idx / sizeof(cell)])
+			>> ((sizeof(cell) - 1 - idx % sizeof(cell)) * 8));
+	}
+
+	// stops after 'max_length' + 1 characters, so that long strings
+	// don't have to be scanned completely just to be truncated
+	size_t GetStringLength(cell const *str, bool packed, size_t max_length)
+	{
+		size_t length = 0;
+		if (packed)
+		{
+			while (length <= max_length && GetPackedChar(str, length) != '\0')
+				++length;
+		}
+		else
+		{
+			while (length <= max_length && str[length] != 0)
+				++length;
+		}
+		return length;
+	}
+
+	void AppendLiteral(std::string &dest, const char *str, bool escape)
+	{
+		for (; *str != '\0'; ++str)
+		{
+			dest.push_back(*str);
+			if (escape && (*str == '{' || *str == '}'))
+				dest.push_back(*str);
+		}
+	}
+}
+
+
+namespace samplog
+{
+	bool NativeCallFormat::Compile(const char *name, const char *params_format)
+	{
+		_paramTypes.clear();
+		_numArguments = _numStrings = 0;
+
+		std::string arg_formats;
+		for (const char *c = params_format; *c != '\0'; ++c)
+		{
+			if (c != params_format)
+				arg_formats.append(", ");
+
+			switch (*c)
+			{
+			case 'd': //decimal
+			case 'i': //integer
+				_paramTypes.push_back(ParamType::INT);
+				arg_formats.append("{:d}");
+				break;
+			case 'f': //float
+				_paramTypes.push_back(ParamType::FLOAT);
+				arg_formats.append("{:f}");
+				break;
+			case 'h': //hexadecimal
+			case 'x': //
+				_paramTypes.push_back(ParamType::INT);
+				arg_formats.append("{:x}");
+				break;
+			case 'b': //binary
+				_paramTypes.push_back(ParamType::INT);
+				arg_formats.append("{:b}");
+				break;
+			case 's': //string
+				_paramTypes.push_back(ParamType::STRING);
+				arg_formats.append("\"{:s}\"");
+				++_numStrings;
+				break;
+			case '*': //censored output
+				_paramTypes.push_back(ParamType::HIDDEN);
+				arg_formats.append("\"*****\"");
+				continue;
+			case 'r': //reference
+				_paramTypes.push_back(ParamType::REFERENCE);
+				arg_formats.append("{:#08x}");
+				break;
+			case 'p': //pointer-value
+				_paramTypes.push_back(ParamType::INT);
+				arg_formats.append("{:#08x}");
+				break;
+			default:
+				return false; //unrecognized format specifier
+			}
+			++_numArguments;
+		}
+
+		// the name is only escaped if the format is actually formatted later
+		_format.clear();
+		AppendLiteral(_format, name, _numArguments != 0);
+		_format.push_back('(');
+		_format.append(arg_formats);
+		_format.push_back(')');
+		return true;
+	}
+
+	void NativeCallFormat::Capture(AMX *amx, cell const *params, size_t max_string_length,
+		LogRecord &record) const
+	{
+		if (_numArguments == 0)
+		{
+			record.SetMessage(_format);
+			return;
+		}
+
+		LogArgument inline_arguments[MAX_INLINE_ARGUMENTS];
+		std::vector<LogArgument> arguments_overflow;
+		LogArgument *arguments = inline_arguments;
+		if (_numArguments > MAX_INLINE_ARGUMENTS)
+		{
+			arguments_overflow.resize(_numArguments);
+			arguments = arguments_overflow.data();
+		}
+
+		StringParam inline_strings[MAX_INLINE_ARGUMENTS];
+		std::vector<StringParam> strings_overflow;
+		StringParam *strings = inline_strings;
+		if (_numStrings > MAX_INLINE_ARGUMENTS)
+		{
+			strings_overflow.resize(_numStrings);
+			strings = strings_overflow.data();
+		}
+
+		if (max_string_length == 0)
+			max_string_length = std::numeric_limits<size_t>::max() - 1;
+
+		// the string lengths have to be known before the record's buffer
+		// is allocated, the characters are copied after that
+		LogArgument *arg = arguments;
+		StringParam *str = strings;
+		for (size_t i = 0; i != _paramTypes.size(); ++i)
+		{
+			cell param = params[i + 1];
+			switch (_paramTypes[i])
+			{
+			case ParamType::INT:
+				arg->type = LogArgument::Type::INT;
+				arg->value.i = param;
+				break;
+			case ParamType::FLOAT:
+				arg->type = LogArgument::Type::DOUBLE;
+				arg->value.d = amx_ctof(param);
+				break;
+			case ParamType::STRING:
+			{
+				cell *addr = nullptr;
+				if (amx_GetAddr(amx, param, &addr) != AMX_ERR_NONE)
+					addr = nullptr;
+				str->Data = addr;
+				str->Packed = addr != nullptr && IsPackedString(addr);
+				str->Length = addr != nullptr
+					? GetStringLength(addr, str->Packed, max_string_length) : 0;
+				str->Truncated = str->Length > max_string_length;
+				if (str->Truncated)
+					str->Length = max_string_length;
+
+				arg->type = LogArgument::Type::STRING;
+				arg->value.s.data = nullptr;
+				arg->value.s.length = str->Length
+					+ (str->Truncated ? sizeof(TRUNCATION_MARKER) - 1 : 0);
+				++str;
+			}	break;
+			case ParamType::REFERENCE:
+			{
+				cell *addr_dest = nullptr;
+				amx_GetAddr(amx, param, &addr_dest);
+				arg->type = LogArgument::Type::UINT;
+				arg->value.u = reinterpret_cast<unsigned int>(addr_dest);
+			}	break;
+			case ParamType::HIDDEN:
+				continue;
+			}
+			++arg;
+		}
+
+		char *dest = record.PrepareFormat(_format.c_str(), arguments, _numArguments);
+		for (StringParam const *s = strings; s != str; ++s)
+		{
+			if (s->Packed)
+			{
+				for (size_t c = 0; c != s->Length; ++c)
+					*dest++ = GetPackedChar(s->Data, c);
+			}
+			else
+			{
+				for (size_t c = 0; c != s->Length; ++c)
+					*dest++ = static_cast<char>(s->Data[c]);
+			}
+
+			if (s->Truncated)
+			{
+				std::memcpy(dest, TRUNCATION_MARKER, sizeof(TRUNCATION_MARKER) - 1);
+				dest += sizeof(TRUNCATION_MARKER) - 1;
+			}
+		}
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <samplog/ILogger.hpp>
+
+class LogRecord;
+
+
+namespace samplog
+{
+	// parameter format of a native function, compiled once to a format
+	// string and the type of every parameter, logging a call then only
+	// captures the raw parameter values into the record, the message is
+	// formatted by the logging thread
+	class NativeCallFormat
+	{
+	public:
+		NativeCallFormat() = default;
+		~NativeCallFormat() = default;
+		NativeCallFormat(NativeCallFormat const &) = delete;
+		NativeCallFormat& operator=(NativeCallFormat const &) = delete;
+		NativeCallFormat(NativeCallFormat &&) = delete;
+		NativeCallFormat& operator=(NativeCallFormat &&) = delete;
+
+	private:
+		enum class ParamType : unsigned char
+		{
+			INT,
+			FLOAT,
+			STRING,
+			REFERENCE,
+			HIDDEN // censored, the value isn't captured at all
+		};
+
+		// captured arguments up to this count are stored on the stack
+		static const size_t MAX_INLINE_ARGUMENTS = 16;
+
+		// a string parameter, located in the AMX's data section
+		struct StringParam
+		{
+			cell const *Data;
+			bool Packed;
+			size_t Length;
+			bool Truncated;
+		};
+
+	private:
+		// format string of the whole call, or the message itself
+		// if no parameter values are captured
+		std::string _format;
+		std::vector<ParamType> _paramTypes;
+		size_t _numArguments = 0;
+		size_t _numStrings = 0;
+
+	public:
+		// returns false if 'params_format' contains an unknown specifier
+		bool Compile(const char *name, const char *params_format);
+
+		// 'params' has to contain at least as many parameters as the format
+		// strings are copied directly from the AMX into the record, strings
+		// longer than 'max_string_length' (0 for no limit) are truncated
+		void Capture(AMX *amx, cell const *params, size_t max_string_length,
+			LogRecord &record) const;
+	};
+}
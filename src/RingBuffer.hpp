@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+
+// bounded lock-free queue, based on Dmitry Vyukov's MPMC queue
+// any number of threads can push and pop concurrently, but the log-core
+// writer thread is usually the only one popping elements
+template<typename T>
+class RingBuffer
+{
+public:
+	explicit RingBuffer(size_t capacity) :
+		_mask(RoundUpCapacity(capacity) - 1),
+		_cells(new Cell[_mask + 1]),
+		_enqueuePos(0),
+		_dequeuePos(0)
+	{
+		for (size_t i = 0; i != _mask + 1; ++i)
+			_cells[i].Sequence.store(i, std::memory_order_relaxed);
+	}
+	~RingBuffer() = default;
+	RingBuffer(RingBuffer const &) = delete;
+	RingBuffer& operator=(RingBuffer const &) = delete;
+	RingBuffer(RingBuffer &&) = delete;
+	RingBuffer& operator=(RingBuffer &&) = delete;
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> Sequence;
+		T Data;
+	};
+
+	static const size_t CACHE_LINE_SIZE = 64;
+
+	static size_t RoundUpCapacity(size_t capacity)
+	{
+		size_t pow2 = 2;
+		while (pow2 < capacity)
+			pow2 <<= 1;
+		return pow2;
+	}
+
+private:
+	size_t const _mask;
+	std::unique_ptr<Cell[]> const _cells;
+
+	// keep producer and consumer positions on separate cache lines
+	char _pad0[CACHE_LINE_SIZE];
+	std::atomic<size_t> _enqueuePos;
+	char _pad1[CACHE_LINE_SIZE];
+	std::atomic<size_t> _dequeuePos;
+	char _pad2[CACHE_LINE_SIZE];
+
+public:
+	inline size_t GetCapacity() const
+	{
+		return _mask + 1;
+	}
+
+	// only an approximation if other threads are pushing/popping concurrently
+	inline size_t GetSize() const
+	{
+		size_t const
+			dequeue_pos = _dequeuePos.load(std::memory_order_relaxed),
+			enqueue_pos = _enqueuePos.load(std::memory_order_relaxed);
+		return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+	}
+
+	inline bool IsEmpty() const
+	{
+		size_t const pos = _dequeuePos.load(std::memory_order_relaxed);
+		size_t const seq = _cells[pos & _mask].Sequence.load(std::memory_order_acquire);
+		return static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0;
+	}
+
+	// 'data' is only moved from if the element could be pushed
+	bool TryPush(T &&data)
+	{
+		Cell *cell;
+		size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+		while (true)
+		{
+			cell = &_cells[pos & _mask];
+			size_t const seq = cell->Sequence.load(std::memory_order_acquire);
+			intptr_t const diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+			if (diff == 0)
+			{
+				if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false; // full
+			}
+			else
+			{
+				pos = _enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->Data = std::move(data);
+		cell->Sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPop(T &dest)
+	{
+		Cell *cell;
+		size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+		while (true)
+		{
+			cell = &_cells[pos & _mask];
+			size_t const seq = cell->Sequence.load(std::memory_order_acquire);
+			intptr_t const diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+			if (diff == 0)
+			{
+				if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false; // empty
+			}
+			else
+			{
+				pos = _dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		dest = std::move(cell->Data);
+		cell->Sequence.store(pos + _mask + 1, std::memory_order_release);
+		return true;
+	}
+};
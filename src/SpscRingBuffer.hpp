@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+
+// bounded lock-free queue for exactly one producer and one consumer thread
+// each side only writes its own position and caches the other side's
+// position, so pushing doesn't touch any cache line the consumer writes to
+// unless the cached position says the queue is full
+template<typename T>
+class SpscRingBuffer
+{
+public:
+	explicit SpscRingBuffer(size_t capacity) :
+		_mask(RoundUpCapacity(capacity) - 1),
+		_data(new T[_mask + 1]),
+		_writePos(0),
+		_cachedReadPos(0),
+		_readPos(0),
+		_cachedWritePos(0)
+	{ }
+	~SpscRingBuffer() = default;
+	SpscRingBuffer(SpscRingBuffer const &) = delete;
+	SpscRingBuffer& operator=(SpscRingBuffer const &) = delete;
+	SpscRingBuffer(SpscRingBuffer &&) = delete;
+	SpscRingBuffer& operator=(SpscRingBuffer &&) = delete;
+
+private:
+	static const size_t CACHE_LINE_SIZE = 64;
+
+	static size_t RoundUpCapacity(size_t capacity)
+	{
+		size_t pow2 = 2;
+		while (pow2 < capacity)
+			pow2 <<= 1;
+		return pow2;
+	}
+
+private:
+	size_t const _mask;
+	std::unique_ptr<T[]> const _data;
+
+	// producer side
+	char _pad0[CACHE_LINE_SIZE];
+	std::atomic<size_t> _writePos;
+	size_t _cachedReadPos;
+
+	// consumer side
+	char _pad1[CACHE_LINE_SIZE];
+	std::atomic<size_t> _readPos;
+	size_t _cachedWritePos;
+	char _pad2[CACHE_LINE_SIZE];
+
+public:
+	inline size_t GetCapacity() const
+	{
+		return _mask + 1;
+	}
+
+	// only an approximation if called from neither the producer nor the consumer
+	inline size_t GetSize() const
+	{
+		size_t const
+			read_pos = _readPos.load(std::memory_order_relaxed),
+			write_pos = _writePos.load(std::memory_order_relaxed);
+		return write_pos > read_pos ? write_pos - read_pos : 0;
+	}
+
+	// producer only
+	// 'data' is only moved from if the element could be pushed
+	bool TryPush(T &&data)
+	{
+		size_t const pos = _writePos.load(std::memory_order_relaxed);
+		if (pos - _cachedReadPos == _mask + 1)
+		{
+			_cachedReadPos = _readPos.load(std::memory_order_acquire);
+			if (pos - _cachedReadPos == _mask + 1)
+				return false; // full
+		}
+
+		_data[pos & _mask] = std::move(data);
+		_writePos.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer only
+	// returns the oldest element without removing it, or nullptr if empty
+	T *GetFront()
+	{
+		size_t const pos = _readPos.load(std::memory_order_relaxed);
+		if (pos == _cachedWritePos)
+		{
+			_cachedWritePos = _writePos.load(std::memory_order_acquire);
+			if (pos == _cachedWritePos)
+				return nullptr;
+		}
+		return &_data[pos & _mask];
+	}
+
+	// consumer only, the queue must not be empty
+	// the element returned by GetFront must not be accessed afterwards
+	void PopFront()
+	{
+		_readPos.store(_readPos.load(std::memory_order_relaxed) + 1,
+			std::memory_order_release);
+	}
+};
@@ -0,0 +1,141 @@
+#include "Timestamp.hpp"
+
+#include <fmt/format.h>
+#include <fmt/time.h>
+
+
+namespace
+{
+	TimestampFormat::MonotonicClock::time_point const MonotonicStartTime =
+		TimestampFormat::MonotonicClock::now();
+}
+
+
+TimestampFormat::TimestampFormat(std::string format) :
+	_format(std::move(format)),
+	_hasSubSecondFields(false),
+	_resolution(60)
+{
+	std::string time_format;
+	for (size_t i = 0; i != _format.size(); ++i)
+	{
+		char const c = _format.at(i);
+		if (c != '%' || i + 1 == _format.size())
+		{
+			time_format.push_back(c);
+			continue;
+		}
+
+		char const specifier = _format.at(++i);
+		SegmentType type;
+		switch (specifier)
+		{
+		case 'L':
+			type = SegmentType::MILLISECONDS;
+			break;
+		case 'f':
+			type = SegmentType::MICROSECONDS;
+			break;
+		case 'N':
+			type = SegmentType::NANOSECONDS;
+			break;
+		case 'K':
+			type = SegmentType::MONOTONIC;
+			break;
+		case 'c':
+		case 'r':
+		case 'S':
+		case 'T':
+		case 'X':
+			// every format not displaying seconds has at most minute resolution
+			_resolution = 1;
+			// fall-through
+		default:
+			time_format.push_back(c);
+			time_format.push_back(specifier);
+			continue;
+		}
+
+		AddTimeSegment(time_format);
+		time_format.clear();
+		_segments.push_back({ type, std::string() });
+		_hasSubSecondFields = true;
+	}
+	AddTimeSegment(time_format);
+}
+
+void TimestampFormat::AddTimeSegment(std::string const &time_format)
+{
+	if (time_format.empty())
+		return;
+
+	_segments.push_back({ SegmentType::TIME, "{:" + time_format + "}" });
+}
+
+TimestampFormat::MonotonicClock::time_point TimestampFormat::GetMonotonicStartTime()
+{
+	return MonotonicStartTime;
+}
+
+std::string const &TimestampCache::Get(TimestampFormat const &format,
+	TimestampFormat::Clock::time_point time,
+	TimestampFormat::MonotonicClock::time_point monotonic_time)
+{
+	using SegmentType = TimestampFormat::SegmentType;
+
+	auto const &segments = format.GetSegments();
+	std::time_t const now_c = TimestampFormat::Clock::to_time_t(time);
+	std::time_t const time_step = now_c / format.GetResolution();
+	if (time_step != _timeStep || _format != format.GetFormat())
+	{
+		auto const tm = fmt::localtime(now_c);
+		_timeSegments.clear();
+		_timestamp.clear();
+		for (auto const &s : segments)
+		{
+			if (s.Type != SegmentType::TIME)
+				continue;
+
+			_timeSegments.push_back(fmt::format(s.FmtFormat, tm));
+			_timestamp.append(_timeSegments.back());
+		}
+		_timeStep = time_step;
+		_format = format.GetFormat();
+	}
+
+	if (!format.HasSubSecondFields())
+		return _timestamp;
+
+	auto const subsecond_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		time.time_since_epoch() % std::chrono::seconds(1)).count();
+
+	fmt::memory_buffer timestamp_buf;
+	size_t time_segment_idx = 0;
+	for (auto const &s : segments)
+	{
+		switch (s.Type)
+		{
+		case SegmentType::TIME:
+			fmt::format_to(timestamp_buf, "{:s}", _timeSegments.at(time_segment_idx++));
+			break;
+		case SegmentType::MILLISECONDS:
+			fmt::format_to(timestamp_buf, "{:03d}", subsecond_ns / 1000000);
+			break;
+		case SegmentType::MICROSECONDS:
+			fmt::format_to(timestamp_buf, "{:06d}", subsecond_ns / 1000);
+			break;
+		case SegmentType::NANOSECONDS:
+			fmt::format_to(timestamp_buf, "{:09d}", subsecond_ns);
+			break;
+		case SegmentType::MONOTONIC:
+		{
+			auto const uptime_us = std::chrono::duration_cast<std::chrono::microseconds>(
+				monotonic_time - MonotonicStartTime).count();
+			fmt::format_to(timestamp_buf, "{:d}.{:06d}",
+				uptime_us / 1000000, uptime_us % 1000000);
+		} break;
+		}
+	}
+	_timestamp = fmt::to_string(timestamp_buf);
+	return _timestamp;
+}
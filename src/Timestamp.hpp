@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+
+
+// a log time format (strftime syntax), precompiled once when
+// the config is (re)loaded
+// additional specifiers:
+//   %L  milliseconds (000-999)
+//   %f  microseconds (000000-999999)
+//   %N  nanoseconds (000000000-999999999)
+//   %K  monotonic time since log-core was loaded, in seconds with
+//       microsecond precision (unaffected by system clock changes)
+class TimestampFormat
+{
+public:
+	using Clock = std::chrono::system_clock;
+	using MonotonicClock = std::chrono::steady_clock;
+
+	enum class SegmentType
+	{
+		TIME, // strftime part
+		MILLISECONDS,
+		MICROSECONDS,
+		NANOSECONDS,
+		MONOTONIC
+	};
+
+	struct Segment
+	{
+		SegmentType Type;
+		std::string FmtFormat; // only used by TIME segments
+	};
+
+public:
+	TimestampFormat() : TimestampFormat("%x %X")
+	{ }
+	explicit TimestampFormat(std::string format);
+
+private:
+	std::string _format;
+	std::vector<Segment> _segments;
+	bool _hasSubSecondFields;
+	std::time_t _resolution; // in seconds
+
+private:
+	void AddTimeSegment(std::string const &time_format);
+
+public:
+	// the reference point of the %K specifier
+	static MonotonicClock::time_point GetMonotonicStartTime();
+
+	inline std::string const &GetFormat() const
+	{
+		return _format;
+	}
+	inline std::vector<Segment> const &GetSegments() const
+	{
+		return _segments;
+	}
+	// whether the format has fields which change more often than every second
+	inline bool HasSubSecondFields() const
+	{
+		return _hasSubSecondFields;
+	}
+	// the finest time unit the strftime parts of the format display, in seconds
+	inline std::time_t GetResolution() const
+	{
+		return _resolution;
+	}
+};
+
+// remembers the last rendered strftime parts of a timestamp, which are reused
+// until the time changes by at least the resolution of the format
+// sub-second fields are rendered for every timestamp
+class TimestampCache
+{
+public:
+	std::string const &Get(TimestampFormat const &format,
+		TimestampFormat::Clock::time_point time,
+		TimestampFormat::MonotonicClock::time_point monotonic_time);
+
+private:
+	std::string _format;
+	std::time_t _timeStep = -1;
+	std::vector<std::string> _timeSegments;
+	std::string _timestamp;
+};
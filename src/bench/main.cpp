@@ -0,0 +1,410 @@
+// logcore-bench: measures the throughput and latency of log-core, every
+// mode measures a different part of it (see PrintUsage)
+// the logging modes write their log files to the "logs" directory of the
+// current directory, along with a temporary log-config.yml enabling the
+// benchmark loggers, so they should be run in an empty directory
+
+#include <fstream>
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+#include <fmt/format.h>
+
+#include "AmxDebugInfo.hpp"
+#include "MappedFile.hpp"
+#include "amx/amx.h"
+#include "amx/amxdbg.h"
+#include <samplog/samplog.hpp>
+
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	const char *CONFIG_FILE_PATH = "log-config.yml";
+
+	void PrintUsage(const char *program_name)
+	{
+		fmt::print(stderr,
+			"usage: {:s} [-n <count>] <mode> [<script>]\n" \
+			"  -n  number of messages or lookups per measurement (default: 200000)\n" \
+			"modes:\n" \
+			"  files  lines per second written to a log file, compared to\n" \
+			"         reopening the file for every line\n" \
+			"  burst  lines per second written when 1, 10 and 100 loggers log\n" \
+			"         their share of the messages at the same time\n" \
+			"  format time spent in the logging call with deferred formatting,\n" \
+			"         compared to formatting the message before logging it\n" \
+			"  lookup time spent looking up the line, file and function of code\n" \
+			"         addresses in the debug info of <script>, compared to amxdbg\n",
+			program_name);
+	}
+
+	double GetSeconds(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// enables the info level of the benchmark loggers, warnings and errors
+	// would also be written to warnings.log/errors.log
+	bool WriteConfig(std::vector<std::string> const &logger_names)
+	{
+		if (std::ifstream(CONFIG_FILE_PATH))
+		{
+			fmt::print(stderr, "'{:s}' already exists, " \
+				"run the benchmark in an empty directory\n", CONFIG_FILE_PATH);
+			return false;
+		}
+
+		std::ofstream file(CONFIG_FILE_PATH);
+		file << "Logger:\n";
+		for (auto const &name : logger_names)
+			file << "  plugins/" << name << ":\n    LogLevel: Info\n";
+		return static_cast<bool>(file);
+	}
+
+	std::string GetLogFilePath(std::string const &logger_name)
+	{
+		return "logs/plugins/" + logger_name + ".log";
+	}
+
+	// the lines are written by the writer threads in the background, so a
+	// measurement only ends once the log file has all of them
+	void WaitForLines(std::string const &file_path, unsigned int num_lines)
+	{
+		std::ifstream file;
+		char buffer[4096];
+		unsigned int lines = 0;
+		while (lines < num_lines)
+		{
+			if (!file.is_open())
+				file.open(file_path, std::ifstream::binary);
+
+			std::streamsize read_size = 0;
+			if (file.is_open())
+			{
+				file.read(buffer, sizeof(buffer));
+				read_size = file.gcount();
+				lines += static_cast<unsigned int>(
+					std::count(buffer, buffer + read_size, '\n'));
+				file.clear();
+			}
+			if (read_size != sizeof(buffer))
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	bool BenchmarkFiles(unsigned int num_messages)
+	{
+		std::string const message(64, 'x');
+
+		// how every line used to be written: open the file, write the line
+		// with its timestamp, flush and close it again
+		const char *reopen_file_path = "logcore-bench-reopen.log";
+		auto start = Clock::now();
+		for (unsigned int i = 0; i != num_messages; ++i)
+		{
+			std::time_t const now = std::time(nullptr);
+			char timestamp[32];
+			std::strftime(timestamp, sizeof(timestamp), "%x %X", std::localtime(&now));
+
+			std::ofstream file(reopen_file_path, std::ofstream::out | std::ofstream::app);
+			file << '[' << timestamp << "] [INFO] " << message << '\n';
+			file.flush();
+		}
+		double const reopen_seconds = GetSeconds(start);
+		std::remove(reopen_file_path);
+
+		std::string const logger_name = "bench-files";
+		if (!WriteConfig({ logger_name }))
+			return false;
+		std::remove(GetLogFilePath(logger_name).c_str());
+
+		samplog::Api::Get();
+		double seconds;
+		{
+			samplog::PluginLogger logger(logger_name);
+			start = Clock::now();
+			for (unsigned int i = 0; i != num_messages; ++i)
+				logger.Log(samplog::LogLevel::INFO, message.c_str());
+			WaitForLines(GetLogFilePath(logger_name), num_messages);
+			seconds = GetSeconds(start);
+		}
+		samplog::Api::Destroy();
+		std::remove(CONFIG_FILE_PATH);
+
+		fmt::print("{:d} lines\n", num_messages);
+		fmt::print("  reopening the file per line: {:10.0f} lines/s\n",
+			num_messages / reopen_seconds);
+		fmt::print("  log-core:                    {:10.0f} lines/s\n",
+			num_messages / seconds);
+		return true;
+	}
+
+	// every logger logs from its own thread, and all threads start at once
+	bool BenchmarkBurst(unsigned int num_messages)
+	{
+		static const unsigned int NUM_LOGGERS[] = { 1, 10, 100 };
+
+		std::vector<std::string> logger_names;
+		for (auto num_loggers : NUM_LOGGERS)
+		{
+			for (unsigned int l = 0; l != num_loggers; ++l)
+				logger_names.push_back(fmt::format("bench-burst-{:d}-{:d}", num_loggers, l));
+		}
+		if (!WriteConfig(logger_names))
+			return false;
+		for (auto const &name : logger_names)
+			std::remove(GetLogFilePath(name).c_str());
+
+		samplog::Api::Get();
+		fmt::print("{:d} lines\n", num_messages);
+		auto logger_name = logger_names.cbegin();
+		for (auto num_loggers : NUM_LOGGERS)
+		{
+			unsigned int const num_logger_messages = num_messages / num_loggers;
+			std::vector<std::unique_ptr<samplog::PluginLogger>> loggers;
+			for (unsigned int l = 0; l != num_loggers; ++l)
+				loggers.emplace_back(new samplog::PluginLogger(*logger_name++));
+
+			std::atomic<bool> started(false);
+			std::vector<std::thread> threads;
+			for (auto &logger : loggers)
+			{
+				threads.emplace_back([&started, num_logger_messages](samplog::PluginLogger *logger)
+				{
+					std::string const message(64, 'x');
+					while (!started)
+						std::this_thread::yield();
+					for (unsigned int i = 0; i != num_logger_messages; ++i)
+						logger->Log(samplog::LogLevel::INFO, message.c_str());
+				}, logger.get());
+			}
+
+			auto const start = Clock::now();
+			started = true;
+			for (auto &t : threads)
+				t.join();
+			for (auto name = logger_name - num_loggers; name != logger_name; ++name)
+				WaitForLines(GetLogFilePath(*name), num_logger_messages);
+			double const seconds = GetSeconds(start);
+
+			fmt::print("  {:3d} loggers: {:10.0f} lines/s\n", num_loggers,
+				num_logger_messages * num_loggers / seconds);
+		}
+		samplog::Api::Destroy();
+		std::remove(CONFIG_FILE_PATH);
+		return true;
+	}
+
+	// the messages are logged in rounds which fit into the queues, with a
+	// pause in between, so that logging never has to wait for the writer
+	template<typename Func>
+	std::vector<double> MeasureLatencies(unsigned int num_messages, Func &&log)
+	{
+		static const unsigned int ROUND_SIZE = 1000;
+
+		std::vector<double> latencies;
+		latencies.reserve(num_messages);
+		for (unsigned int i = 0; i != num_messages; ++i)
+		{
+			auto const start = Clock::now();
+			log(i);
+			latencies.push_back(std::chrono::duration<double, std::nano>(
+				Clock::now() - start).count());
+
+			if ((i + 1) % ROUND_SIZE == 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+		std::sort(latencies.begin(), latencies.end());
+		return latencies;
+	}
+
+	void PrintLatencies(const char *name, std::vector<double> const &latencies)
+	{
+		double const mean = std::accumulate(latencies.begin(), latencies.end(), 0.0)
+			/ latencies.size();
+		fmt::print("  {:s} mean {:6.0f} ns, median {:6.0f} ns, 99th percentile {:6.0f} ns\n",
+			name, mean, latencies[latencies.size() / 2],
+			latencies[latencies.size() * 99 / 100]);
+	}
+
+	bool BenchmarkFormat(unsigned int num_messages)
+	{
+		std::string const logger_name = "bench-format";
+		if (!WriteConfig({ logger_name }))
+			return false;
+		std::remove(GetLogFilePath(logger_name).c_str());
+
+		samplog::Api::Get();
+		{
+			samplog::PluginLogger logger(logger_name);
+			std::string const player_name = "Some_Player";
+			auto const preformatted_latencies = MeasureLatencies(num_messages,
+				[&](unsigned int i)
+			{
+				logger.Log(samplog::LogLevel::INFO, fmt::format(
+					"player {:d} ({:s}) moved to {:.2f}, {:.2f}",
+					i, player_name, i * 0.5, i * 0.25).c_str());
+			});
+			auto const deferred_latencies = MeasureLatencies(num_messages,
+				[&](unsigned int i)
+			{
+				logger.Log(samplog::LogLevel::INFO,
+					"player {:d} ({:s}) moved to {:.2f}, {:.2f}",
+					i, player_name, i * 0.5, i * 0.25);
+			});
+			WaitForLines(GetLogFilePath(logger_name), 2 * num_messages);
+
+			fmt::print("{:d} messages with 4 arguments\n", num_messages);
+			PrintLatencies("formatted before logging:", preformatted_latencies);
+			PrintLatencies("deferred formatting:     ", deferred_latencies);
+		}
+		samplog::Api::Destroy();
+		std::remove(CONFIG_FILE_PATH);
+		return true;
+	}
+
+	// random code addresses are looked up once with the sorted tables of
+	// AmxDebugInfo, and once with the linear scans of amxdbg, which call
+	// traces were resolved with before
+	bool BenchmarkLookup(unsigned int num_lookups, std::string const &script_path)
+	{
+		MappedFile file;
+		AmxDebugInfo debug_info;
+		auto start = Clock::now();
+		if (!file.Open(script_path) || !debug_info.Load(file))
+		{
+			fmt::print(stderr, "'{:s}' is not a script with debug info\n", script_path);
+			return false;
+		}
+		double const load_seconds = GetSeconds(start);
+
+		AMX_DBG amxdbg;
+		FILE *amx_file = std::fopen(script_path.c_str(), "rb");
+		start = Clock::now();
+		int const error = amx_file != nullptr
+			? dbg_LoadInfo(&amxdbg, amx_file) : AMX_ERR_NOTFOUND;
+		double const amxdbg_load_seconds = GetSeconds(start);
+		if (amx_file != nullptr)
+			std::fclose(amx_file);
+		if (error != AMX_ERR_NONE)
+		{
+			fmt::print(stderr, "amxdbg can't load the debug info of '{:s}': {:d}\n",
+				script_path, error);
+			return false;
+		}
+
+		auto const *header = reinterpret_cast<AMX_HEADER const *>(file.GetData());
+		ucell const code_size = header->dat - header->cod;
+		std::mt19937 random_engine(1234);
+		std::uniform_int_distribution<ucell> distribution(0, code_size / sizeof(cell) - 1);
+		std::vector<ucell> addresses(num_lookups);
+		for (auto &address : addresses)
+			address = distribution(random_engine) * sizeof(cell);
+
+		// the results are counted, so that the lookups can't be optimized out
+		// amxdbg also finds a line for addresses behind the last line entry,
+		// which log-core treats as invalid, so the counts can differ a bit
+		unsigned int found = 0;
+		start = Clock::now();
+		for (auto address : addresses)
+		{
+			int line;
+			const char *file_name, *function_name;
+			found += debug_info.LookupLine(address, line)
+				+ debug_info.LookupFile(address, file_name)
+				+ debug_info.LookupFunction(address, function_name);
+		}
+		double const seconds = GetSeconds(start);
+
+		unsigned int amxdbg_found = 0;
+		start = Clock::now();
+		for (auto address : addresses)
+		{
+			int line;
+			const char *file_name, *function_name;
+			amxdbg_found += (dbg_LookupLine(&amxdbg, address, &line) == AMX_ERR_NONE)
+				+ (dbg_LookupFile(&amxdbg, address, &file_name) == AMX_ERR_NONE)
+				+ (dbg_LookupFunction(&amxdbg, address, &function_name) == AMX_ERR_NONE);
+		}
+		double const amxdbg_seconds = GetSeconds(start);
+		dbg_FreeInfo(&amxdbg);
+
+		fmt::print("{:d} lookups of line, file and function in {:d} KiB of code\n",
+			num_lookups, code_size / 1024);
+		fmt::print("  amxdbg:       load {:8.2f} ms, {:10.0f} ns per lookup ({:d} found)\n",
+			amxdbg_load_seconds * 1000.0, amxdbg_seconds * 1e9 / num_lookups, amxdbg_found);
+		fmt::print("  AmxDebugInfo: load {:8.2f} ms, {:10.0f} ns per lookup ({:d} found)\n",
+			load_seconds * 1000.0, seconds * 1e9 / num_lookups, found);
+		return true;
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	int count = 200000;
+	int arg_idx = 1;
+	for (; arg_idx < argc && argv[arg_idx][0] == '-'; ++arg_idx)
+	{
+		if (std::strcmp(argv[arg_idx], "-n") == 0 && arg_idx + 1 < argc)
+		{
+			count = std::atoi(argv[++arg_idx]);
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (arg_idx == argc || count <= 0)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	std::string const mode = argv[arg_idx++];
+	int const num_mode_args = mode == "lookup" ? 1 : 0;
+	if (argc - arg_idx != num_mode_args)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	bool succeeded;
+	if (mode == "files")
+	{
+		succeeded = BenchmarkFiles(static_cast<unsigned int>(count));
+	}
+	else if (mode == "burst")
+	{
+		succeeded = BenchmarkBurst(static_cast<unsigned int>(count));
+	}
+	else if (mode == "format")
+	{
+		succeeded = BenchmarkFormat(static_cast<unsigned int>(count));
+	}
+	else if (mode == "lookup")
+	{
+		succeeded = BenchmarkLookup(static_cast<unsigned int>(count), argv[arg_idx]);
+	}
+	else
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+	return succeeded ? 0 : 1;
+}
@@ -61,6 +61,7 @@ namespace
 		LogManager::Get()->LogInternal(LogLevel::INFO, err_msg);
 		LogManager::Get()->LogInternal(LogLevel::INFO,
 			"log-core has detected a server crash and will now safely shut itself down");
+		// shutting down writes all buffered log data, regardless of flush policies
 		LogManager::Get()->Destroy();
 
 		return EXCEPTION_CONTINUE_EXECUTION;
@@ -0,0 +1,202 @@
+// logcore-decode: converts binary log files (loggers configured with
+// "Format: Binary") back into the text format of regular log files
+// AMX call traces are resolved with the debug info of the scripts in the
+// server directory, which have to be unchanged since the files were written
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <cstring>
+
+#include <fmt/format.h>
+
+#include "AmxDebugInfo.hpp"
+#include "BinaryLog.hpp"
+#include "LogRecord.hpp"
+#include "MappedFile.hpp"
+#include "Timestamp.hpp"
+#include "utils.hpp"
+
+
+namespace
+{
+	// debug info of the scripts by their path, nullptr if it couldn't be loaded,
+	// kept until the end, as the resolved call traces point into it
+	using DebugInfoMap = std::unordered_map<std::string, std::unique_ptr<AmxDebugInfo>>;
+
+	void PrintUsage(const char *program_name)
+	{
+		fmt::print(stderr,
+			"usage: {:s} [-t <time format>] [-m] [-d <server directory>] <file>...\n" \
+			"  -t  log time format, same as 'LogTimeFormat' in log-config.yml " \
+			"(default: \"%x %X\")\n" \
+			"  -m  print the module name in each line, like in warnings.log\n" \
+			"  -d  server directory with the scripts of the AMX call traces " \
+			"(default: current directory)\n",
+			program_name);
+	}
+
+	AmxDebugInfo const *GetDebugInfo(std::string const &script_path,
+		std::string const &server_dir, DebugInfoMap &debug_infos)
+	{
+		auto it = debug_infos.find(script_path);
+		if (it != debug_infos.end())
+			return it->second.get();
+
+		std::unique_ptr<AmxDebugInfo> debug_info(new AmxDebugInfo);
+		MappedFile file;
+		if (!file.Open(server_dir + "/" + script_path) || !debug_info->Load(file))
+		{
+			fmt::print(stderr, "could not load the debug info of script '{:s}', " \
+				"its call traces are left out\n", script_path);
+			debug_info.reset();
+		}
+		return (debug_infos[script_path] = std::move(debug_info)).get();
+	}
+
+	// binary log files store the format arguments and AMX code addresses
+	// of the records, which are formatted and resolved here
+	void ResolveRecord(LogRecord &record, std::string const &script_path,
+		std::string const &server_dir, DebugInfoMap &debug_infos)
+	{
+		record.ApplyFormat();
+
+		if (record.GetAmxCodeAddressCount() == 0)
+			return;
+
+		std::vector<samplog::AmxFuncCallInfo> call_trace;
+		auto const *debug_info = GetDebugInfo(script_path, server_dir, debug_infos);
+		if (debug_info != nullptr)
+		{
+			ResolveAmxCallTrace(record.GetAmxCodeAddresses(),
+				record.GetAmxCodeAddressCount(), call_trace,
+				[debug_info](ucell address, samplog::AmxFuncCallInfo &dest)
+			{
+				return debug_info->LookupFunctionCall(address, dest);
+			});
+		}
+		record.SetCallTrace(call_trace);
+		record.ClearAmxCodeAddresses();
+	}
+
+	bool DecodeFile(std::string const &file_path, TimestampFormat const &time_format,
+		bool print_module_name, std::string const &server_dir, DebugInfoMap &debug_infos)
+	{
+		std::ifstream file(file_path, std::ifstream::binary);
+		if (!file)
+		{
+			fmt::print(stderr, "could not open file '{:s}'\n", file_path);
+			return false;
+		}
+
+		binlog::Reader reader(file);
+		std::string module_name;
+		uint32_t version;
+		if (!reader.ReadHeader(module_name, version))
+		{
+			fmt::print(stderr, "'{:s}' is not a binary log file\n", file_path);
+			return false;
+		}
+		if (version > binlog::VERSION)
+		{
+			fmt::print(stderr, "'{:s}' has unsupported format version {:d}\n",
+				file_path, version);
+			return false;
+		}
+
+		TimestampCache timestamp_cache;
+		fmt::memory_buffer line;
+		LogRecord record;
+		// only a file ending exactly after a record is complete
+		while (!reader.IsAtEnd())
+		{
+			if (!reader.ReadRecord(record))
+			{
+				fmt::print(stderr, "'{:s}' is truncated or corrupted\n", file_path);
+				return false;
+			}
+			ResolveRecord(record, reader.GetScriptPath(), server_dir, debug_infos);
+
+			auto const &time_str = timestamp_cache.Get(time_format,
+				record.Time, record.MonotonicTime);
+			line.resize(0);
+			if (print_module_name)
+			{
+				fmt::format_to(line, "[{:s}] [{:s}] [{:s}] {:s}\n",
+					time_str, module_name, utils::GetLogLevelAsString(record.Level),
+					record.GetFormattedMessage());
+			}
+			else
+			{
+				fmt::format_to(line, "[{:s}] [{:s}] {:s}\n",
+					time_str, utils::GetLogLevelAsString(record.Level),
+					record.GetFormattedMessage());
+			}
+			std::cout.write(line.data(), line.size());
+		}
+
+		if (file.bad())
+		{
+			fmt::print(stderr, "could not read file '{:s}'\n", file_path);
+			return false;
+		}
+		return true;
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	std::string time_format = "%x %X";
+	bool print_module_name = false;
+	std::string server_dir = ".";
+	int arg_idx = 1;
+	for (; arg_idx < argc && argv[arg_idx][0] == '-'; ++arg_idx)
+	{
+		if (std::strcmp(argv[arg_idx], "-t") == 0 && arg_idx + 1 < argc)
+		{
+			time_format = argv[++arg_idx];
+		}
+		else if (std::strcmp(argv[arg_idx], "-m") == 0)
+		{
+			print_module_name = true;
+		}
+		else if (std::strcmp(argv[arg_idx], "-d") == 0 && arg_idx + 1 < argc)
+		{
+			server_dir = argv[++arg_idx];
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (arg_idx == argc)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	bool success = true;
+	try
+	{
+		TimestampFormat const timestamp_format(time_format);
+		DebugInfoMap debug_infos;
+		for (; arg_idx < argc; ++arg_idx)
+		{
+			success = DecodeFile(argv[arg_idx], timestamp_format, print_module_name,
+				server_dir, debug_infos) && success;
+		}
+	}
+	catch (std::exception const &e)
+	{
+		fmt::print(stderr, "error: {:s}\n", e.what());
+		return 1;
+	}
+	std::cout.flush();
+	return success ? 0 : 1;
+}
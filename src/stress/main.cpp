@@ -0,0 +1,197 @@
+// logcore-stress: captures call traces of AMX scripts from many threads
+// while the scripts are registered and erased again over and over, to
+// check the synchronization of the AMX debug info
+// has to run in a server directory, only scripts listed in server.cfg or
+// stored in the filterscripts directory are indexed with their debug info
+// like the plugin itself it only works in 32-bit builds, because call
+// traces are read from the AMX memory through cell-sized pointers
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+#include <fmt/format.h>
+
+#include "amx/amx.h"
+#include <samplog/samplog.hpp>
+
+
+namespace
+{
+	struct Script
+	{
+		std::string FilePath;
+		std::vector<unsigned char> Memory;
+		AMX Amx;
+	};
+
+	void PrintUsage(const char *program_name)
+	{
+		fmt::print(stderr,
+			"usage: {:s} [-t <threads>] [-s <seconds>] <script>...\n" \
+			"  -t  number of threads capturing call traces (default: 8)\n" \
+			"  -s  duration of the test in seconds (default: 3)\n",
+			program_name);
+	}
+
+	bool LoadScript(std::string const &file_path, Script &script)
+	{
+		std::ifstream file(file_path, std::ifstream::binary);
+		if (!file)
+		{
+			fmt::print(stderr, "could not open script '{:s}'\n", file_path);
+			return false;
+		}
+
+		script.FilePath = file_path;
+		script.Memory.assign(std::istreambuf_iterator<char>(file),
+			std::istreambuf_iterator<char>());
+
+		auto const *header = reinterpret_cast<AMX_HEADER const *>(script.Memory.data());
+		if (script.Memory.size() < sizeof(AMX_HEADER)
+			|| header->magic != AMX_MAGIC
+			|| (header->flags & AMX_FLAG_DEBUG) == 0
+			|| header->cod < static_cast<int32_t>(sizeof(AMX_HEADER))
+			|| header->dat - header->cod < static_cast<int32_t>(4 * sizeof(cell))
+			|| static_cast<size_t>(header->dat) > script.Memory.size())
+		{
+			fmt::print(stderr, "'{:s}' is not a script with debug info\n", file_path);
+			return false;
+		}
+
+		// fake call stack behind the script: two frames returning into the
+		// code section, a frame holds the previous frame and the return address
+		size_t const stack_offset = (script.Memory.size() + sizeof(cell) - 1)
+			& ~(sizeof(cell) - 1);
+		script.Memory.resize(stack_offset + 4 * sizeof(cell));
+		header = reinterpret_cast<AMX_HEADER const *>(script.Memory.data());
+
+		cell const cell_size = sizeof(cell);
+		cell const code_size = header->dat - header->cod;
+		cell const frame = static_cast<cell>(stack_offset) - header->dat;
+		cell *stack = reinterpret_cast<cell *>(script.Memory.data() + stack_offset);
+		stack[0] = frame + 2 * cell_size;
+		stack[1] = (code_size / 2) & ~(cell_size - 1);
+		stack[2] = 0;
+		stack[3] = code_size - cell_size;
+
+		std::memset(&script.Amx, 0, sizeof(AMX));
+		script.Amx.base = script.Memory.data();
+		script.Amx.cip = cell_size;
+		script.Amx.frm = frame;
+		return true;
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	int num_threads = 8;
+	int seconds = 3;
+	int arg_idx = 1;
+	for (; arg_idx < argc && argv[arg_idx][0] == '-'; ++arg_idx)
+	{
+		if (std::strcmp(argv[arg_idx], "-t") == 0 && arg_idx + 1 < argc)
+		{
+			num_threads = std::atoi(argv[++arg_idx]);
+		}
+		else if (std::strcmp(argv[arg_idx], "-s") == 0 && arg_idx + 1 < argc)
+		{
+			seconds = std::atoi(argv[++arg_idx]);
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (arg_idx == argc || num_threads <= 0 || seconds <= 0)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	std::vector<std::unique_ptr<Script>> scripts;
+	for (; arg_idx < argc; ++arg_idx)
+	{
+		std::unique_ptr<Script> script(new Script);
+		if (!LoadScript(argv[arg_idx], *script))
+			return 1;
+		scripts.push_back(std::move(script));
+	}
+
+	auto *api = samplog::Api::Get();
+	std::atomic<bool> stop(false);
+	std::atomic<bool> failed(false);
+	std::atomic<unsigned long long> num_traces(0), num_resolved_traces(0);
+	unsigned long long num_cycles = 0;
+	{
+		samplog::PluginLogger logger("logcore-stress");
+		std::vector<std::thread> threads;
+		for (int t = 0; t != num_threads; ++t)
+		{
+			threads.emplace_back([&, t]()
+			{
+				std::vector<samplog::AmxFuncCallInfo> call_trace;
+				unsigned long long traces = 0, resolved_traces = 0;
+				while (!stop)
+				{
+					AMX *amx = &scripts[(traces + t) % scripts.size()]->Amx;
+					call_trace.clear();
+					if (api->GetAmxFunctionCallTrace(amx, call_trace))
+					{
+						// the names may only be accessed while the AMX is registered
+						if (call_trace.empty() || call_trace.front().file == nullptr)
+							failed = true;
+						++resolved_traces;
+					}
+
+					// the logging threads resolve the call traces of these
+					if ((traces & 255) == 0)
+						logger.Log(amx, samplog::LogLevel::ERROR, "call trace {:d}", traces);
+					++traces;
+				}
+				num_traces += traces;
+				num_resolved_traces += resolved_traces;
+			});
+		}
+
+		auto const end_time = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+		while (std::chrono::steady_clock::now() < end_time)
+		{
+			for (auto &s : scripts)
+				api->RegisterAmx(&s->Amx);
+			for (auto &s : scripts)
+				api->EraseAmx(&s->Amx);
+			++num_cycles;
+		}
+
+		stop = true;
+		for (auto &t : threads)
+			t.join();
+	}
+	samplog::Api::Destroy();
+
+	fmt::print("{:d} register/erase cycles, {:d} call traces ({:d} resolved)\n",
+		num_cycles, num_traces.load(), num_resolved_traces.load());
+	if (failed)
+	{
+		fmt::print(stderr, "invalid call traces were returned\n");
+		return 1;
+	}
+	if (num_resolved_traces == 0)
+	{
+		fmt::print(stderr, "no call trace could be resolved, " \
+			"are the scripts indexed with their debug info?\n");
+		return 1;
+	}
+	return 0;
+}
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <mutex>
 
 #ifdef WIN32
 #  include <Windows.h>
@@ -79,21 +80,20 @@ void utils::EnsureFolders(std::string const &path)
 
 void utils::EnsureTerminalColorSupport()
 {
-	static bool enabled = false;
-	if (enabled)
-		return;
-
+	// called by every writer thread printing colored messages
+	static std::once_flag enabled;
+	std::call_once(enabled, []()
+	{
 #ifdef WIN32
-	HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
-	if (console == INVALID_HANDLE_VALUE)
-		return;
+		HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+		if (console == INVALID_HANDLE_VALUE)
+			return;
 
-	DWORD console_opts;
-	if (!GetConsoleMode(console, &console_opts))
-		return;
+		DWORD console_opts;
+		if (!GetConsoleMode(console, &console_opts))
+			return;
 
-	if (!SetConsoleMode(console, console_opts | ENABLE_VIRTUAL_TERMINAL_PROCESSING))
-		return;
+		SetConsoleMode(console, console_opts | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
 #endif
-	enabled = true;
+	});
 }